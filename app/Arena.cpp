@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Arena.h"
+
+
+// a monotonic arena.  allocations are carved off the end of the current block
+// and never freed one at a time.  instead the whole arena is reset, which
+// keeps its biggest block for next time, so a parser that's handed one
+// document after another soon stops going to the heap at all
+
+
+static const size_t firstBlockSize = 64 * 1024;
+static const size_t largestBlockSize = 16 * 1024 * 1024;
+
+static thread_local Arena *currentArena = nullptr;
+
+
+struct Arena::PrivateImpl
+{
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::vector<size_t> blockSizes;
+    
+    char *blockData;
+    size_t blockRemaining;
+    size_t nextBlockSize;
+};
+
+
+Arena::Scope::Scope(Arena& arena) :
+    m_previous(currentArena)
+{
+    // make the arena the one ArenaAllocator uses on this thread, until the
+    // scope ends
+    
+    currentArena = &arena;
+}
+
+
+Arena::Scope::~Scope()
+{
+    currentArena = m_previous;
+}
+
+
+Arena::Arena() :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+    {
+        m_impl->blockData = nullptr;
+        m_impl->blockRemaining = 0;
+        m_impl->nextBlockSize = firstBlockSize;
+    }
+}
+
+
+Arena::~Arena()
+{
+    if(m_impl)
+        delete m_impl;
+}
+
+
+void Arena::reset()
+{
+    // forget everything allocated so far.  the biggest block stays to be
+    // carved up again, and the rest go back to the heap
+    
+    if(!m_impl)
+        return;
+    
+    if(m_impl->blocks.empty())
+        return;
+    
+    
+    size_t largest = std::max_element(m_impl->blockSizes.begin(),m_impl->blockSizes.end()) - m_impl->blockSizes.begin();
+    
+    std::unique_ptr<char[]> block = std::move(m_impl->blocks[largest]);
+    size_t blockSize = m_impl->blockSizes[largest];
+    
+    m_impl->blocks.clear();
+    m_impl->blockSizes.clear();
+    
+    m_impl->blockData = block.get();
+    m_impl->blockRemaining = blockSize;
+    
+    m_impl->blocks.push_back(std::move(block));
+    m_impl->blockSizes.push_back(blockSize);
+}
+
+
+void Arena::reserve(size_t size)
+{
+    // make sure the next block is at least this big, so something whose size
+    // is roughly known up front fits in one
+    
+    if(!m_impl)
+        return;
+    
+    if(size > m_impl->blockRemaining)
+        m_impl->nextBlockSize = std::max(m_impl->nextBlockSize,size);
+}
+
+
+void *Arena::allocate(size_t size,size_t alignment)
+{
+    if(!m_impl)
+        throw std::bad_alloc();
+    
+    size_t padding = (alignment - ((uintptr_t) m_impl->blockData & (alignment - 1))) & (alignment - 1);
+    
+    if(padding + size > m_impl->blockRemaining)
+    {
+        // start a new block, twice the size of the last up to a point, or
+        // bigger if the allocation needs it.  new[] aligns it for anything
+        size_t blockSize = std::max(m_impl->nextBlockSize,size + alignment);
+        
+        m_impl->blocks.emplace_back(new char[blockSize]);
+        m_impl->blockSizes.push_back(blockSize);
+        
+        m_impl->blockData = m_impl->blocks.back().get();
+        m_impl->blockRemaining = blockSize;
+        m_impl->nextBlockSize = std::min(largestBlockSize,std::max(m_impl->nextBlockSize,blockSize) * 2);
+        
+        padding = 0;
+    }
+    
+    void *data = m_impl->blockData + padding;
+    
+    m_impl->blockData += padding + size;
+    m_impl->blockRemaining -= padding + size;
+    
+    return data;
+}
+
+
+size_t Arena::memoryUsage() const
+{
+    if(!m_impl)
+        return 0;
+    
+    size_t bytes = sizeof(PrivateImpl);
+    
+    for(size_t blockSize : m_impl->blockSizes)
+        bytes += blockSize;
+    
+    return bytes;
+}
+
+
+Arena *Arena::current()
+{
+    return currentArena;
+}
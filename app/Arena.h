@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <new>
+
+
+class Arena
+{
+    public:
+        class Scope
+        {
+            public:
+                Scope(Arena& arena);
+                ~Scope();
+                
+            private:
+                Arena *m_previous;
+        };
+        
+    public:
+        Arena();
+        ~Arena();
+        
+        void reset();
+        void reserve(size_t size);
+        
+        void *allocate(size_t size,size_t alignment);
+        
+        size_t memoryUsage() const;
+        
+        static Arena *current();
+        
+    private:
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
+
+
+// a standard allocator that takes its memory from the arena in scope on this
+// thread when it's made, and from the heap when there isn't one.  freeing
+// arena memory does nothing, since it all goes at once when the arena is
+// reset.  containers using it have to be destroyed while the same arena is in
+// scope, since anything they make to free their contents looks the arena up
+// again
+
+template<typename T>
+class ArenaAllocator
+{
+    public:
+        typedef T value_type;
+        
+    public:
+        ArenaAllocator() :
+            m_arena(Arena::current())
+        {
+        }
+        
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) :
+            m_arena(other.arena())
+        {
+        }
+        
+        T *allocate(size_t count)
+        {
+            if(m_arena)
+                return (T *) m_arena->allocate(count * sizeof(T),alignof(T));
+            
+            return (T *) ::operator new(count * sizeof(T));
+        }
+        
+        void deallocate(T *data,size_t)
+        {
+            if(!m_arena)
+                ::operator delete(data);
+        }
+        
+        Arena *arena() const
+        {
+            return m_arena;
+        }
+        
+    private:
+        Arena *m_arena;
+};
+
+
+template<typename T,typename U>
+inline bool operator==(const ArenaAllocator<T>& a,const ArenaAllocator<U>& b)
+{
+    return a.arena() == b.arena();
+}
+
+
+template<typename T,typename U>
+inline bool operator!=(const ArenaAllocator<T>& a,const ArenaAllocator<U>& b)
+{
+    return a.arena() != b.arena();
+}
@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include "BlockEncoder.h"
+
+
+// tile art can go to the GPU block compressed, which takes a quarter to an
+// eighth of the memory and of the bus.  each 4x4 block of pixels is stored
+// as two end colors and an index per pixel into the colors between them:
+//
+//     BC1  8 bytes a block, RGB, 565 ends and 4 colors
+//     BC7  16 bytes a block, RGBA, here always mode 6:  7777 ends with a
+//          shared low bit each, and 16 colors
+//
+// the ends are picked along the direction the block's colors spread the
+// most, and every pixel takes the nearest color.  that's a long way from the
+// best either format can do, but it's fast enough to run on the decoding
+// threads, and hard to tell apart on photographic art
+
+
+struct PixelBlock
+{
+    // a block of pixels as RGBA, and the direction they spread the most
+    float pixels[16][4];
+    float mean[4];
+    float axis[4];
+};
+
+
+static void readBlock(const unsigned char *data,int width,int height,int bytesPerPixel,int blockX,int blockY,PixelBlock& block)
+{
+    // the edges of an image that isn't a multiple of 4 are filled out by
+    // repeating its last row and column
+    
+    for(int y = 0;y < 4;++y)
+    {
+        for(int x = 0;x < 4;++x)
+        {
+            int pixelX = std::min(blockX * 4 + x,width - 1);
+            int pixelY = std::min(blockY * 4 + y,height - 1);
+            
+            const unsigned char *pixel = data + ((size_t) pixelY * width + pixelX) * bytesPerPixel;
+            float *out = block.pixels[y * 4 + x];
+            
+            out[0] = pixel[0];
+            out[1] = pixel[1];
+            out[2] = pixel[2];
+            out[3] = bytesPerPixel == 4 ? pixel[3] : 255.0f;
+        }
+    }
+}
+
+
+static void findAxis(PixelBlock& block,int channels)
+{
+    // the principal axis of the colors, by a few rounds of power iteration
+    // on their covariance
+    
+    float covariance[4][4] = {};
+    
+    for(int channel = 0;channel < 4;++channel)
+    {
+        block.mean[channel] = 0.0f;
+        
+        for(int index = 0;index < 16;++index)
+            block.mean[channel] += block.pixels[index][channel] / 16.0f;
+    }
+    
+    for(int index = 0;index < 16;++index)
+    {
+        for(int row = 0;row < channels;++row)
+        {
+            for(int column = 0;column < channels;++column)
+                covariance[row][column] += (block.pixels[index][row] - block.mean[row]) * (block.pixels[index][column] - block.mean[column]);
+        }
+    }
+    
+    
+    float axis[4] = { 1.0f,1.0f,1.0f,channels == 4 ? 1.0f : 0.0f };
+    
+    for(int iteration = 0;iteration < 8;++iteration)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        
+        for(int row = 0;row < channels;++row)
+        {
+            for(int column = 0;column < channels;++column)
+                next[row] += covariance[row][column] * axis[column];
+            
+            length = std::max(length,std::fabs(next[row]));
+        }
+        
+        // a flat block has no direction, and any will do
+        if(length < 1e-6f)
+            break;
+        
+        for(int channel = 0;channel < channels;++channel)
+            axis[channel] = next[channel] / length;
+    }
+    
+    memcpy(block.axis,axis,sizeof(axis));
+}
+
+
+static void findEnds(const PixelBlock& block,int channels,float low[4],float high[4])
+{
+    // the colors at either end of the block along its axis
+    
+    float lowest = 0.0f;
+    float highest = 0.0f;
+    float length = 0.0f;
+    
+    for(int channel = 0;channel < channels;++channel)
+        length += block.axis[channel] * block.axis[channel];
+    
+    for(int index = 0;index < 16;++index)
+    {
+        float distance = 0.0f;
+        
+        for(int channel = 0;channel < channels;++channel)
+            distance += (block.pixels[index][channel] - block.mean[channel]) * block.axis[channel];
+        
+        lowest = std::min(lowest,distance);
+        highest = std::max(highest,distance);
+    }
+    
+    if(length > 0.0f)
+    {
+        lowest /= length;
+        highest /= length;
+    }
+    
+    for(int channel = 0;channel < 4;++channel)
+    {
+        float axis = channel < channels ? block.axis[channel] : 0.0f;
+        
+        low[channel] = std::max(0.0f,std::min(255.0f,block.mean[channel] + axis * lowest));
+        high[channel] = std::max(0.0f,std::min(255.0f,block.mean[channel] + axis * highest));
+    }
+}
+
+
+static int nearest(const float pixel[4],const float palette[][4],int colors,int channels)
+{
+    int best = 0;
+    float bestError = 1e30f;
+    
+    for(int color = 0;color < colors;++color)
+    {
+        float error = 0.0f;
+        
+        for(int channel = 0;channel < channels;++channel)
+            error += (pixel[channel] - palette[color][channel]) * (pixel[channel] - palette[color][channel]);
+        
+        if(error < bestError)
+        {
+            best = color;
+            bestError = error;
+        }
+    }
+    
+    return best;
+}
+
+
+static uint16_t packRgb565(const float color[4])
+{
+    int red = (int) std::lround(color[0] * 31.0f / 255.0f);
+    int green = (int) std::lround(color[1] * 63.0f / 255.0f);
+    int blue = (int) std::lround(color[2] * 31.0f / 255.0f);
+    
+    return (uint16_t) ((red << 11) | (green << 5) | blue);
+}
+
+
+static void unpackRgb565(uint16_t packed,float color[4])
+{
+    int red = (packed >> 11) & 31;
+    int green = (packed >> 5) & 63;
+    int blue = packed & 31;
+    
+    color[0] = (float) ((red << 3) | (red >> 2));
+    color[1] = (float) ((green << 2) | (green >> 4));
+    color[2] = (float) ((blue << 3) | (blue >> 2));
+    color[3] = 255.0f;
+}
+
+
+static void encodeBc1(PixelBlock& block,unsigned char *out)
+{
+    findAxis(block,3);
+    
+    float low[4];
+    float high[4];
+    
+    findEnds(block,3,low,high);
+    
+    
+    // the first end has to be the larger for the block to have 4 colors.
+    // if they're the same the block is one color, and every index is 0
+    uint16_t color0 = packRgb565(high);
+    uint16_t color1 = packRgb565(low);
+    
+    if(color0 < color1)
+        std::swap(color0,color1);
+    
+    uint32_t indices = 0;
+    
+    if(color0 != color1)
+    {
+        float palette[4][4];
+        
+        unpackRgb565(color0,palette[0]);
+        unpackRgb565(color1,palette[1]);
+        
+        for(int channel = 0;channel < 3;++channel)
+        {
+            palette[2][channel] = (2.0f * palette[0][channel] + palette[1][channel]) / 3.0f;
+            palette[3][channel] = (palette[0][channel] + 2.0f * palette[1][channel]) / 3.0f;
+        }
+        
+        for(int index = 0;index < 16;++index)
+            indices |= (uint32_t) nearest(block.pixels[index],palette,4,3) << (index * 2);
+    }
+    
+    
+    out[0] = (unsigned char) (color0 & 0xff);
+    out[1] = (unsigned char) (color0 >> 8);
+    out[2] = (unsigned char) (color1 & 0xff);
+    out[3] = (unsigned char) (color1 >> 8);
+    
+    for(int byte = 0;byte < 4;++byte)
+        out[4 + byte] = (unsigned char) (indices >> (byte * 8));
+}
+
+
+static void quantizeBc7(const float color[4],int ends[4],int& lowBit)
+{
+    // a mode 6 end is 7 bits a channel and one low bit for all four.  take
+    // whichever low bit lands closer
+    
+    float bestError = 1e30f;
+    
+    for(int bit = 0;bit < 2;++bit)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        
+        for(int channel = 0;channel < 4;++channel)
+        {
+            candidate[channel] = std::max(0,std::min(127,(int) std::lround((color[channel] - bit) / 2.0f)));
+            
+            float value = (float) (candidate[channel] * 2 + bit);
+            error += (value - color[channel]) * (value - color[channel]);
+        }
+        
+        if(error < bestError)
+        {
+            bestError = error;
+            lowBit = bit;
+            memcpy(ends,candidate,sizeof(candidate));
+        }
+    }
+}
+
+
+static void writeBits(unsigned char *out,int& position,uint32_t value,int bits)
+{
+    for(int bit = 0;bit < bits;++bit,++position)
+    {
+        if(value & (1u << bit))
+            out[position / 8] |= (unsigned char) (1 << (position % 8));
+    }
+}
+
+
+static void encodeBc7(PixelBlock& block,unsigned char *out)
+{
+    static const int weights[16] = { 0,4,9,13,17,21,26,30,34,38,43,47,51,55,60,64 };
+    
+    findAxis(block,4);
+    
+    float low[4];
+    float high[4];
+    
+    findEnds(block,4,low,high);
+    
+    int ends[2][4];
+    int lowBits[2];
+    
+    quantizeBc7(low,ends[0],lowBits[0]);
+    quantizeBc7(high,ends[1],lowBits[1]);
+    
+    
+    float palette[16][4];
+    
+    for(int color = 0;color < 16;++color)
+    {
+        for(int channel = 0;channel < 4;++channel)
+        {
+            int end0 = ends[0][channel] * 2 + lowBits[0];
+            int end1 = ends[1][channel] * 2 + lowBits[1];
+            
+            palette[color][channel] = (float) (((64 - weights[color]) * end0 + weights[color] * end1 + 32) >> 6);
+        }
+    }
+    
+    int indices[16];
+    
+    for(int index = 0;index < 16;++index)
+        indices[index] = nearest(block.pixels[index],palette,16,4);
+    
+    
+    // the first pixel's index is stored without its top bit, which has to be
+    // 0.  if it isn't, the ends trade places and every index turns around
+    if(indices[0] >= 8)
+    {
+        std::swap(ends[0],ends[1]);
+        std::swap(lowBits[0],lowBits[1]);
+        
+        for(int index = 0;index < 16;++index)
+            indices[index] = 15 - indices[index];
+    }
+    
+    memset(out,0,16);
+    
+    int position = 0;
+    writeBits(out,position,1 << 6,7);
+    
+    for(int channel = 0;channel < 4;++channel)
+    {
+        writeBits(out,position,ends[0][channel],7);
+        writeBits(out,position,ends[1][channel],7);
+    }
+    
+    writeBits(out,position,lowBits[0],1);
+    writeBits(out,position,lowBits[1],1);
+    
+    for(int index = 0;index < 16;++index)
+        writeBits(out,position,indices[index],index == 0 ? 3 : 4);
+}
+
+
+bool BlockEncoder::encode(const Image& image,Image::Compression compression,Image& encoded)
+{
+    // compress every level of an image.  it has to be RGB or RGBA, and
+    // BC1 drops the alpha
+    
+    if(!image.valid()  ||  image.compression() != Image::CompressionNone  ||
+       (image.bitsPerPixel() != 24  &&  image.bitsPerPixel() != 32))
+    {
+        std::cerr << "BlockEncoder::encode:  error encoding image:  not RGB or RGBA" << std::endl;
+        return false;
+    }
+    
+    int bitsPerPixel;
+    
+    switch(compression)
+    {
+        case Image::CompressionBc1:
+            bitsPerPixel = 4;
+            break;
+        
+        case Image::CompressionBc7:
+            bitsPerPixel = 8;
+            break;
+        
+        default:
+            std::cerr << "BlockEncoder::encode:  error encoding image:  unsupported compression '" << Image::name(compression) << "'" << std::endl;
+            return false;
+    }
+    
+    
+    int width = image.width();
+    int height = image.height();
+    int levels = image.levels();
+    int bytesPerPixel = image.bitsPerPixel() / 8;
+    int blockBytes = bitsPerPixel * 2;
+    
+    unsigned char *data = new unsigned char[Image::size(width,height,bitsPerPixel,levels,compression)];
+    unsigned char *out = data;
+    PixelBlock block;
+    
+    for(int level = 0;level < levels;++level)
+    {
+        const unsigned char *pixels = (const unsigned char *) image.pixelData(level);
+        int levelWidth = std::max(1,width >> level);
+        int levelHeight = std::max(1,height >> level);
+        
+        for(int blockY = 0;blockY < (levelHeight + 3) / 4;++blockY)
+        {
+            for(int blockX = 0;blockX < (levelWidth + 3) / 4;++blockX)
+            {
+                readBlock(pixels,levelWidth,levelHeight,bytesPerPixel,blockX,blockY,block);
+                
+                if(compression == Image::CompressionBc1)
+                    encodeBc1(block,out);
+                else
+                    encodeBc7(block,out);
+                
+                out += blockBytes;
+            }
+        }
+    }
+    
+    return encoded.adopt(data,width,height,bitsPerPixel,nullptr,levels,compression);
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "Image.h"
+
+
+class BlockEncoder
+{
+    public:
+        static bool encode(const Image& image,Image::Compression compression,Image& encoded);
+};
@@ -0,0 +1,95 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+#include "CacheFiles.h"
+
+
+uint64_t stableHash(const char *data,size_t size)
+{
+    // FNV-1a.  this has to be stable from one run to the next, so we can't
+    // use std::hash
+    
+    uint64_t hash = 14695981039346656037ull;
+    
+    for(size_t index = 0;index < size;++index)
+    {
+        hash ^= (unsigned char) data[index];
+        hash *= 1099511628211ull;
+    }
+    
+    return hash;
+}
+
+
+std::string hashName(const std::string& text)
+{
+    // hash some text into a file name
+    
+    char name[17];
+    std::snprintf(name,sizeof(name),"%016llx",(unsigned long long) stableHash(text.data(),text.size()));
+    
+    return name;
+}
+
+
+bool makeDirectory(const std::string& directory)
+{
+    // make the directory if it isn't there, and check we can write to it
+
+#ifdef _WIN32
+    ::_mkdir(directory.c_str());
+#else
+    ::mkdir(directory.c_str(),0755);
+#endif
+    
+    std::ofstream probe(directory + "/.probe",std::ios_base::binary);
+    bool writable = probe.is_open();
+    probe.close();
+    
+    std::remove((directory + "/.probe").c_str());
+    
+    return writable;
+}
+
+
+bool replaceFile(const std::string& filename,const std::string& header,const char *data,size_t size)
+{
+    // write a header and the data after it to a temporary file and move it
+    // into place, so a reader never sees a partially written file.  the
+    // temporary name is unique in case two threads write the same file at
+    // once
+    
+    static std::atomic<unsigned int> sequence(0);
+    std::string temporary = filename + "." + std::to_string(sequence++) + ".tmp";
+    
+    std::ofstream file(temporary,std::ios_base::binary);
+    
+    if(!file.is_open())
+        return false;
+    
+    file.write(header.data(),header.size());
+    file.write(data,size);
+    file.close();
+    
+    if(!file)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    
+    
+    std::remove(filename.c_str());
+    
+    if(std::rename(temporary.c_str(),filename.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    
+    return true;
+}
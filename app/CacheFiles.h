@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// what the caches on disk have in common:  a hash that's stable from one run
+// to the next, file names made from it, a directory that has to be writable,
+// and files that are replaced whole or not at all
+
+uint64_t stableHash(const char *data,size_t size);
+std::string hashName(const std::string& text);
+
+bool makeDirectory(const std::string& directory);
+bool replaceFile(const std::string& filename,const std::string& header,const char *data,size_t size);
@@ -0,0 +1,41 @@
+#include <atomic>
+#include "CancellationToken.h"
+
+
+// copies of a token share its state, so whoever holds one copy can cancel the
+// work that's watching another.  once cancelled, a token stays cancelled
+
+
+struct CancellationToken::PrivateImpl
+{
+    std::atomic<bool> cancelled;
+};
+
+
+CancellationToken::CancellationToken() :
+    m_impl(std::make_shared<PrivateImpl>())
+{
+    if(m_impl)
+        m_impl->cancelled = false;
+}
+
+
+CancellationToken::~CancellationToken()
+{
+}
+
+
+void CancellationToken::cancel()
+{
+    if(m_impl)
+        m_impl->cancelled = true;
+}
+
+
+bool CancellationToken::cancelled() const
+{
+    if(!m_impl)
+        return false;
+    
+    return m_impl->cancelled;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <memory>
+
+
+class CancellationToken
+{
+    public:
+        CancellationToken();
+        ~CancellationToken();
+        
+        void cancel();
+        bool cancelled() const;
+        
+    private:
+        struct PrivateImpl;
+        std::shared_ptr<PrivateImpl> m_impl;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+typedef uint32_t TileId;
+typedef uint32_t UrlId;
+
+struct Tile
+{
+    std::string name;
+    std::string releaseDate;
+    std::string rating;
+    std::string url;
+    std::string videoUrl;
+};
+
+struct TileSet
+{
+    std::string name;
+    std::string refId;
+    std::vector<TileId> tiles;
+    int columnOffset;
+    bool loaded;
+};
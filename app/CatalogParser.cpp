@@ -0,0 +1,72 @@
+#include "CatalogParser.h"
+#include "DomCatalogParser.h"
+#include "StreamCatalogParser.h"
+#ifdef USE_SIMDJSON
+#include "SimdjsonCatalogParser.h"
+#endif
+
+
+// every backend takes the document in chunks, as it downloads.  the stream
+// backend parses each chunk as it arrives.  the others collect the chunks and
+// parse the whole document in finish()
+//
+// the tiles go into a table of the parser's own as they're found, and the
+// rows refer to them by id.  takeTileSets() hands over the rows along with
+// that table
+
+
+bool CatalogParser::available(Backend backend)
+{
+    // the simdjson backend is only there if it was turned on in the build
+
+    switch(backend)
+    {
+        case BackendDom:
+        case BackendStream:
+            return true;
+
+        case BackendSimdjson:
+#ifdef USE_SIMDJSON
+            return true;
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+
+const char *CatalogParser::name(Backend backend)
+{
+    switch(backend)
+    {
+        case BackendDom:        return "dom";
+        case BackendStream:     return "stream";
+        case BackendSimdjson:   return "simdjson";
+    }
+
+    return "";
+}
+
+
+std::shared_ptr<CatalogParser> CatalogParser::create(Backend backend,Document document)
+{
+    switch(backend)
+    {
+        case BackendDom:
+            return std::make_shared<DomCatalogParser>(document);
+
+        case BackendStream:
+            return std::make_shared<StreamCatalogParser>(document);
+
+        case BackendSimdjson:
+#ifdef USE_SIMDJSON
+            return std::make_shared<SimdjsonCatalogParser>(document);
+#else
+            break;
+#endif
+    }
+
+    return std::shared_ptr<CatalogParser>();
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "Catalog.h"
+#include "TileTable.h"
+
+
+class CatalogParser
+{
+    public:
+        enum Backend
+        {
+            BackendDom,
+            BackendStream,
+            BackendSimdjson
+        };
+        
+        enum Document
+        {
+            HomeDocument,
+            SetDocument
+        };
+        
+    public:
+        virtual ~CatalogParser() {}
+        
+        virtual void reset() = 0;
+        
+        virtual bool feed(const char *data,size_t size) = 0;
+        virtual bool finish() = 0;
+        
+        virtual std::vector<TileSet> takeTileSets(TileTable& tiles) = 0;
+        
+        static bool available(Backend backend);
+        static const char *name(Backend backend);
+        static std::shared_ptr<CatalogParser> create(Backend backend,Document document);
+};
@@ -0,0 +1,174 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "CacheFiles.h"
+#include "CatalogSnapshot.h"
+#include "MappedFile.h"
+#include "Serialization.h"
+
+
+// a snapshot is the resolved rows and their tile table, written out as they
+// sit in memory so they can be read back without any parsing.  the file is
+// a header followed by the payload:
+//
+//     header   "DPCS", version, byte order, payload size, payload checksum
+//     payload  the tile table, then the number of rows, then each row's name,
+//              refId, whether it's loaded, and the ids of its tiles
+//
+// anything that doesn't match, from an older version or another machine, or
+// that's been cut short, is ignored and the catalog comes from the network
+
+
+static const char magic[4] = { 'D','P','C','S' };
+static const uint32_t version = 1;
+static const uint32_t byteOrder = 0x01020304;
+
+
+static void writeText(std::string& out,const std::string& text)
+{
+    writeValue(out,(uint32_t) text.size());
+    writeBytes(out,text.data(),text.size());
+}
+
+
+static bool readText(const char *&data,const char *end,std::string& text)
+{
+    uint32_t size;
+    const char *bytes;
+    
+    if(!readValue(data,end,size)  ||  !readBytes(data,end,size,bytes))
+        return false;
+    
+    text.assign(bytes,size);
+    return true;
+}
+
+
+bool CatalogSnapshot::save(const std::string& filename,const std::vector<TileSet>& tileSets,const TileTable& tiles)
+{
+    // write the rows and their tiles.  the file is written to one side and
+    // moved into place, so a reader never sees half of it
+    
+    std::string payload;
+    
+    tiles.write(payload);
+    
+    writeValue(payload,(uint32_t) tileSets.size());
+    
+    for(const TileSet& tileSet : tileSets)
+    {
+        writeText(payload,tileSet.name);
+        writeText(payload,tileSet.refId);
+        writeValue(payload,(uint32_t) tileSet.loaded);
+        writeValue(payload,(uint32_t) tileSet.tiles.size());
+        writeBytes(payload,(const char *) tileSet.tiles.data(),tileSet.tiles.size() * sizeof(TileId));
+    }
+    
+    
+    std::string header;
+    
+    writeBytes(header,magic,sizeof(magic));
+    writeValue(header,version);
+    writeValue(header,byteOrder);
+    writeValue(header,(uint64_t) payload.size());
+    writeValue(header,stableHash(payload.data(),payload.size()));
+    
+    
+    if(!replaceFile(filename,header,payload.data(),payload.size()))
+    {
+        std::cerr << "CatalogSnapshot::save:  error writing '" << filename << "'" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+
+bool CatalogSnapshot::load(const std::string& filename,std::vector<TileSet>& tileSets,TileTable& tiles)
+{
+    // map a snapshot and read the rows and tiles straight out of it.  the
+    // strings are copied into the table rather than pointed at, so the file
+    // is closed again by the time this returns and can be replaced on the way
+    // out.  a missing snapshot isn't an error, just a cold start
+    
+    MappedFile file;
+    
+    if(!file.open(filename))
+        return false;
+    
+    const char *data = file.data();
+    const char *end = data + file.size();
+    
+    
+    char fileMagic[sizeof(magic)];
+    uint32_t fileVersion;
+    uint32_t fileByteOrder;
+    uint64_t payloadSize;
+    uint64_t payloadChecksum;
+    
+    if(!readValue(data,end,fileMagic)  ||  !readValue(data,end,fileVersion)  ||
+       !readValue(data,end,fileByteOrder)  ||  !readValue(data,end,payloadSize)  ||
+       !readValue(data,end,payloadChecksum))
+    {
+        std::cerr << "CatalogSnapshot::load:  error reading '" << filename << "':  no header" << std::endl;
+        return false;
+    }
+    
+    if(memcmp(fileMagic,magic,sizeof(magic)) != 0  ||  fileVersion != version  ||  fileByteOrder != byteOrder)
+    {
+        std::cerr << "CatalogSnapshot::load:  error reading '" << filename << "':  wrong version" << std::endl;
+        return false;
+    }
+    
+    if(payloadSize != (uint64_t) (end - data)  ||  stableHash(data,(size_t) payloadSize) != payloadChecksum)
+    {
+        std::cerr << "CatalogSnapshot::load:  error reading '" << filename << "':  damaged" << std::endl;
+        return false;
+    }
+    
+    
+    TileTable snapshotTiles;
+    std::vector<TileSet> snapshotSets;
+    uint32_t rowCount;
+    
+    bool ok = snapshotTiles.read(data,end)  &&  readValue(data,end,rowCount);
+    
+    for(uint32_t row = 0;ok  &&  row < rowCount;++row)
+    {
+        TileSet tileSet;
+        tileSet.columnOffset = 0;
+        
+        uint32_t loaded;
+        uint32_t tileCount;
+        const char *ids;
+        
+        ok = readText(data,end,tileSet.name)  &&  readText(data,end,tileSet.refId)  &&
+             readValue(data,end,loaded)  &&  readValue(data,end,tileCount)  &&
+             readBytes(data,end,(size_t) tileCount * sizeof(TileId),ids);
+        
+        if(!ok)
+            break;
+        
+        tileSet.loaded = loaded != 0;
+        tileSet.tiles.resize(tileCount);
+        memcpy(tileSet.tiles.data(),ids,(size_t) tileCount * sizeof(TileId));
+        
+        for(TileId id : tileSet.tiles)
+            ok = ok  &&  id < snapshotTiles.size();
+        
+        snapshotSets.push_back(std::move(tileSet));
+    }
+    
+    if(!ok  ||  data != end)
+    {
+        std::cerr << "CatalogSnapshot::load:  error reading '" << filename << "':  damaged" << std::endl;
+        return false;
+    }
+    
+    
+    tileSets.swap(snapshotSets);
+    tiles.swap(snapshotTiles);
+    
+    return true;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Catalog.h"
+#include "TileTable.h"
+
+
+class CatalogSnapshot
+{
+    public:
+        static bool save(const std::string& filename,const std::vector<TileSet>& tileSets,const TileTable& tiles);
+        static bool load(const std::string& filename,std::vector<TileSet>& tileSets,TileTable& tiles);
+};
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "BlockEncoder.h"
+#include "CacheFiles.h"
+#include "DecodePool.h"
+
+
+// downloaded images are decoded on a few threads of their own, so decoding
+// one image overlaps fetching the next.  the pool holds a bounded number of
+// jobs, counting the ones that are queued, being decoded, or done and not yet
+// taken back.  once it's full, whoever feeds it should stop pulling in
+// downloads until it has room, which holds the network back to the speed we
+// can decode at
+
+
+struct DecodePool::PrivateImpl
+{
+    std::vector<std::thread> threads;
+    Completion completion;
+    TextureCache *cache;
+    Image::Compression compression;
+    
+    mutable std::mutex mutex;
+    std::condition_variable jobQueued;
+    std::condition_variable jobDone;
+    
+    std::deque<Job> queued;
+    std::deque<Job> done;
+    int decoding;
+    int capacity;
+    bool stopping;
+};
+
+
+DecodePool::DecodePool() :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+    {
+        m_impl->cache = nullptr;
+        m_impl->compression = Image::CompressionNone;
+        m_impl->decoding = 0;
+        m_impl->capacity = 0;
+        m_impl->stopping = false;
+    }
+}
+
+
+DecodePool::~DecodePool()
+{
+    if(m_impl)
+    {
+        stop();
+        delete m_impl;
+    }
+}
+
+
+void DecodePool::setCompletion(const Completion& completion)
+{
+    // the completion is called on the decoding thread as soon as a job is
+    // decoded, before it's handed back through next().  it has to be set
+    // before the pool is started
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->completion = completion;
+}
+
+
+void DecodePool::setTextureCache(TextureCache *cache)
+{
+    // with a texture cache, an image that's been decoded before at the same
+    // width is read back from it instead, and one that hasn't is decoded
+    // with its mip levels and written to it.  it has to be set before the
+    // pool is started
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->cache = cache;
+}
+
+
+void DecodePool::setCompression(Image::Compression compression)
+{
+    // when set, images are block compressed once they're decoded, with their
+    // mip levels, ready to go to the GPU as they are.  opaque art is
+    // compressed this way, and art with alpha always with BC7, as BC1 can
+    // only cut pixels out.  it has to be set before the pool is started
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->compression = compression;
+}
+
+
+bool DecodePool::start(int threads,int capacity)
+{
+    // start the decoding threads.  if none can be started, submit() decodes
+    // on the calling thread instead
+    
+    if(!m_impl)
+        return false;
+    
+    stop();
+    
+    
+    m_impl->stopping = false;
+    m_impl->capacity = std::max(1,capacity);
+    
+    for(int index = 0;index < threads;++index)
+    {
+        try
+        {
+            m_impl->threads.emplace_back(run,this);
+        }
+        catch(const std::system_error& error)
+        {
+            std::cerr << "DecodePool::start:  error starting thread:  " << error.what() << std::endl;
+            break;
+        }
+    }
+    
+    return !m_impl->threads.empty();
+}
+
+
+void DecodePool::stop()
+{
+    // stop the threads once they finish what they're decoding.  anything
+    // still queued or not taken back is dropped
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->mutex.lock();
+    m_impl->stopping = true;
+    m_impl->jobQueued.notify_all();
+    m_impl->mutex.unlock();
+    
+    for(std::thread& thread : m_impl->threads)
+        thread.join();
+    
+    m_impl->threads.clear();
+    m_impl->queued.clear();
+    m_impl->done.clear();
+    m_impl->decoding = 0;
+}
+
+
+bool DecodePool::full() const
+{
+    if(!m_impl)
+        return false;
+    
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    
+    return (int) (m_impl->queued.size() + m_impl->done.size()) + m_impl->decoding >= m_impl->capacity;
+}
+
+
+int DecodePool::pending() const
+{
+    if(!m_impl)
+        return 0;
+    
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    
+    return (int) (m_impl->queued.size() + m_impl->done.size()) + m_impl->decoding;
+}
+
+
+void DecodePool::submit(Job& job)
+{
+    // queue a job to be decoded.  its data is moved into the pool, and comes
+    // back with it through next().  this doesn't check for room, so check
+    // full() before taking on the download
+    
+    if(!m_impl)
+        return;
+    
+    job.image.reset();
+    job.stored = false;
+    
+    if(m_impl->threads.empty())
+    {
+        decode(job);
+        
+        std::lock_guard<std::mutex> lock(m_impl->mutex);
+        m_impl->done.push_back(std::move(job));
+        return;
+    }
+    
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    
+    m_impl->queued.push_back(std::move(job));
+    m_impl->jobQueued.notify_one();
+}
+
+
+bool DecodePool::next(Job& job)
+{
+    // take back a job that's been decoded.  its image is null if it couldn't
+    // be.  this returns false if none are done
+    
+    if(!m_impl)
+        return false;
+    
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    
+    if(m_impl->done.empty())
+        return false;
+    
+    job = std::move(m_impl->done.front());
+    m_impl->done.pop_front();
+    
+    return true;
+}
+
+
+void DecodePool::wait(int timeout)
+{
+    // wait until a job is done, or for the timeout (in milliseconds)
+    
+    if(!m_impl)
+        return;
+    
+    std::unique_lock<std::mutex> lock(m_impl->mutex);
+    
+    m_impl->jobDone.wait_for(lock,std::chrono::milliseconds(timeout),[this]() { return !m_impl->done.empty()  ||  (m_impl->queued.empty()  &&  m_impl->decoding == 0); });
+}
+
+
+void DecodePool::decode(Job& job)
+{
+    // decode at no more than the job's decode width, if it has one.  the
+    // cache knows an image by its url and width and a hash of its data, so
+    // art that's changed under the same url is decoded again
+    
+    auto start = std::chrono::steady_clock::now();
+    
+    std::shared_ptr<Image> image = std::make_shared<Image>();
+    TextureCache *cache = m_impl->cache;
+    Image::Compression compression = m_impl->compression;
+    uint64_t contentHash = cache ? stableHash(job.data.data(),job.data.size()) : 0;
+    
+    bool loaded = cache  &&  cache->load(job.url,job.decodeWidth,compression,contentHash,*image);
+    
+    if(!loaded)
+    {
+        if(job.decodeWidth > 0)
+            loaded = image->loadScaled((const unsigned char *) job.data.data(),(int) job.data.size(),job.decodeWidth);
+        else
+            loaded = image->load((const unsigned char *) job.data.data(),(int) job.data.size());
+        
+        // the mip levels are made here whenever they're to be kept or
+        // compressed, since neither can be done to them on the GPU
+        if(loaded  &&  (cache  ||  compression != Image::CompressionNone)  &&  image->generateLevels())
+        {
+            if(compression != Image::CompressionNone  &&  (image->bitsPerPixel() == 24  ||  image->bitsPerPixel() == 32))
+            {
+                std::shared_ptr<Image> encoded = std::make_shared<Image>();
+                
+                if(BlockEncoder::encode(*image,image->bitsPerPixel() == 32 ? Image::CompressionBc7 : compression,*encoded))
+                    image = std::move(encoded);
+            }
+            
+            if(cache)
+                cache->store(job.url,job.decodeWidth,compression,contentHash,*image);
+        }
+    }
+    
+    if(loaded)
+        job.image = std::move(image);
+    
+    job.decodeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    if(m_impl->completion)
+        m_impl->completion(job);
+}
+
+
+void DecodePool::run(DecodePool *object)
+{
+    // this function runs on each decoding thread, taking jobs off the queue
+    // until the pool is stopped
+    
+    PrivateImpl *impl = object->m_impl;
+    
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock(impl->mutex);
+        impl->jobQueued.wait(lock,[impl]() { return impl->stopping  ||  !impl->queued.empty(); });
+        
+        if(impl->stopping)
+            break;
+        
+        Job job = std::move(impl->queued.front());
+        impl->queued.pop_front();
+        ++impl->decoding;
+        
+        lock.unlock();
+        
+        object->decode(job);
+        
+        lock.lock();
+        
+        --impl->decoding;
+        impl->done.push_back(std::move(job));
+        impl->jobDone.notify_all();
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include "Catalog.h"
+#include "Image.h"
+#include "TextureCache.h"
+
+
+class DecodePool
+{
+    public:
+        struct Job
+        {
+            std::string url;
+            std::string data;
+            UrlId id;
+            int width;
+            int decodeWidth;
+            unsigned generation;
+            
+            std::shared_ptr<Image> image;
+            double decodeTime;
+            bool stored;
+        };
+        
+        typedef std::function<void(Job& job)> Completion;
+        
+    public:
+        DecodePool();
+        ~DecodePool();
+        
+        void setCompletion(const Completion& completion);
+        void setTextureCache(TextureCache *cache);
+        void setCompression(Image::Compression compression);
+        
+        bool start(int threads,int capacity);
+        void stop();
+        
+        bool full() const;
+        int pending() const;
+        
+        void submit(Job& job);
+        bool next(Job& job);
+        void wait(int timeout);
+        
+    private:
+        void decode(Job& job);
+        
+        static void run(DecodePool *object);
+        
+        
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -1,6 +1,9 @@
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iostream>
+#include "CatalogParser.h"
+#include "CatalogSnapshot.h"
 #include "DisneyWindow.h"
 #include "glad/glad.h"
 #define GLFW_INCLUDE_NONE
@@ -8,12 +11,177 @@
 #include "WebSupplicant.h"
 
 
+static const char *homeUrl = "https://cd-static.bamgrid.com/dp-117731241344/home.json";
+
+
+static std::string setUrl(const std::string& refId)
+{
+    return std::string("https://cd-static.bamgrid.com/dp-117731241344/sets/") + refId + ".json";
+}
+
+
+static WebSupplicant::Sink parserSink(std::shared_ptr<CatalogParser> parser)
+{
+    // feed a download into a parser as it arrives.  the sink is called with
+    // nullptr when the transfer starts, or starts over, so the parser does
+    // too
+    
+    return [parser](const char *data,size_t size)
+    {
+        if(!data)
+        {
+            parser->reset();
+            return true;
+        }
+        
+        return parser->feed(data,size);
+    };
+}
+
+
+static int imageWidthStep(int pixels)
+{
+    // the widths we ask the image service for.  snapping to a few steps keeps
+    // the number of variants, and so the number of cache entries, small
+    
+    static const int steps[] = { 160,240,320,480,640,960,1280,1920 };
+    
+    for(int step : steps)
+    {
+        if(step >= pixels)
+            return step;
+    }
+    
+    return steps[sizeof(steps) / sizeof(steps[0]) - 1];
+}
+
+
+static std::string queryUrl(const std::string& url,const std::string& name,const std::string& value)
+{
+    // ask the image service for a particular width or format by setting a
+    // query parameter, replacing it if it's already there
+    
+    size_t query = url.find('?');
+    
+    if(query == std::string::npos)
+        return url + "?" + name + "=" + value;
+    
+    
+    size_t start = query;
+    
+    while(start != std::string::npos)
+    {
+        if(url.compare(start + 1,name.size(),name) == 0  &&  url.compare(start + 1 + name.size(),1,"=") == 0)
+        {
+            size_t end = url.find('&',start + 1);
+            
+            return url.substr(0,start + name.size() + 2) + value + (end == std::string::npos ? std::string() : url.substr(end));
+        }
+        
+        start = url.find('&',start + 1);
+    }
+    
+    return url + "&" + name + "=" + value;
+}
+
+
+static void fillRows(std::vector<TileSet>& tileSets,TileTable& tiles,const std::string& refId,const TileSet& tileSet,const TileTable& setTiles)
+{
+    // fill in every row waiting on refId with a set from its own document.
+    // the set's tiles are copied into the rows' table once, and every row
+    // shares them
+    
+    std::vector<TileId> ids;
+    bool copied = false;
+    
+    for(TileSet& row : tileSets)
+    {
+        if(row.loaded  ||  row.refId != refId)
+            continue;
+        
+        if(!copied)
+        {
+            ids.reserve(tileSet.tiles.size());
+            
+            for(TileId id : tileSet.tiles)
+                ids.push_back(tiles.add(setTiles,id));
+            
+            copied = true;
+        }
+        
+        if(!tileSet.name.empty())
+            row.name = tileSet.name;
+        
+        row.tiles = ids;
+        row.loaded = true;
+    }
+}
+
+
+static std::chrono::steady_clock::time_point secondsFromNow(double seconds)
+{
+    return std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+
+static std::string rowKey(const TileSet& tileSet)
+{
+    // what makes a row the same row from one catalog to the next.  rows that
+    // come from a set are known by its refId, and the rest by their name
+    
+    if(!tileSet.refId.empty())
+        return "ref:" + tileSet.refId;
+    
+    return "name:" + tileSet.name;
+}
+
+
+static std::string tileKey(const TileTable& tiles,TileId id)
+{
+    // everything about a tile, so a tile that's the same from one catalog to
+    // the next can be told from one that has changed
+    
+    std::string key = tiles.name(id);
+    
+    key += '\0';
+    key += tiles.releaseDate(id);
+    key += '\0';
+    key += tiles.rating(id);
+    key += '\0';
+    key += tiles.urlText(tiles.url(id));
+    key += '\0';
+    key += tiles.urlText(tiles.videoUrl(id));
+    
+    return key;
+}
+
+
 DisneyWindow::DisneyWindow(std::string binaryPath) :
     m_binaryPath(binaryPath),
+    m_urlGeneration(0),
+    m_bootstrapState(BootstrapCatalog),
+    m_gridShown(false),
+    m_lazyLoading(false),
+    m_prefetchDistance(1),
+    m_sizedImages(false),
+    m_scaledDecoding(true),
+    m_webpImages(false),
+    m_parserBackend(CatalogParser::BackendStream),
+    m_snapshots(true),
+    m_textureCaching(false),
+    m_compressedTextures(false),
+    m_textureCompression(Image::CompressionNone),
+    m_warmStart(false),
+    m_refreshInterval(0.0),
+    m_imageWidth(0),
+    m_viewportChanged(false),
+    m_stopping(false),
     m_rowOffset(0),
     m_selectionRow(0),
     m_selectionColumn(0)
 {
+    setImageBudget(256 << 20);
+    setTextureBudget(256 << 20);
 }
 
 
@@ -22,6 +190,135 @@ DisneyWindow::~DisneyWindow()
 }
 
 
+void DisneyWindow::setLazyLoading(bool lazyLoading,int prefetchDistance)
+{
+    // when loading lazily, sets and tile images are only requested once they
+    // come within prefetchDistance rows or columns of the visible grid.  this
+    // has to be set before the window is created
+    
+    m_lazyLoading = lazyLoading;
+    m_prefetchDistance = std::max(0,prefetchDistance);
+}
+
+
+void DisneyWindow::setParserBackend(CatalogParser::Backend backend)
+{
+    // pick how the catalog documents are parsed.  a backend that wasn't
+    // built in is ignored.  this has to be set before the window is created
+    
+    if(!CatalogParser::available(backend))
+    {
+        std::cerr << "DisneyWindow::setParserBackend:  error selecting backend '" << CatalogParser::name(backend) << "':  not built in" << std::endl;
+        return;
+    }
+    
+    m_parserBackend = backend;
+}
+
+
+void DisneyWindow::setSnapshots(bool snapshots)
+{
+    // when on, the resolved catalog is saved on the way out, and the next
+    // launch puts it on screen straight away while the worker brings it up
+    // to date.  this has to be set before the window is created
+    
+    m_snapshots = snapshots;
+}
+
+
+void DisneyWindow::setTextureCaching(bool textureCaching)
+{
+    // when on, tile art is kept on disk as it was decoded, mip levels and
+    // all, and read back from there rather than decoded again on the next
+    // launch.  nothing prunes the directory, so it's off unless asked for.
+    // this has to be set before the window is created
+    
+    m_textureCaching = textureCaching;
+}
+
+
+void DisneyWindow::setCompressedTextures(bool compressedTextures)
+{
+    // when on, tile art is block compressed on the decoding threads before it
+    // goes to the GPU, in whichever format the context takes, which cuts the
+    // memory and upload time of each texture by 4 to 8 times.  this has to
+    // be set before the window is created
+    
+    m_compressedTextures = compressedTextures;
+}
+
+
+void DisneyWindow::setRefreshInterval(double seconds)
+{
+    // once the grid is up, fetch the catalog again every so many seconds and
+    // bring the rows up to date with it.  0 never does.  this has to be set
+    // before the window is created
+    
+    m_refreshInterval = std::max(0.0,seconds);
+}
+
+
+void DisneyWindow::setImageBudget(size_t bytes)
+{
+    // the most decoded tile art to keep in memory.  past it, whatever was
+    // used least recently is let go of, and loaded again if it comes back on
+    // screen.  0 keeps everything.  this has to be set before the window is
+    // created
+    
+    m_imageResidency.setBudget(bytes);
+}
+
+
+void DisneyWindow::setTextureBudget(size_t bytes)
+{
+    // the most tile textures to keep on the GPU, the same way
+    
+    m_textureResidency.setBudget(bytes);
+}
+
+
+void DisneyWindow::setEncodedBudget(size_t bytes)
+{
+    // when set, tile art is also kept as it was downloaded, up to this many
+    // bytes, which is a small fraction of what it takes decoded.  art is only
+    // decoded once its tile comes within the prefetch distance of the screen,
+    // and when decoded art is let go of it's decoded again from memory rather
+    // than fetched.  0 keeps nothing encoded.  this has to be set before the
+    // window is created
+    
+    m_encodedResidency.setBudget(bytes);
+}
+
+
+void DisneyWindow::setScaledDecoding(bool scaledDecoding)
+{
+    // when on, tile art is decoded at the width it's drawn rather than at
+    // its full size, which takes less time and a lot less memory
+    
+    m_scaledDecoding = scaledDecoding;
+}
+
+
+void DisneyWindow::setSizedImages(bool sizedImages)
+{
+    // when sizing images, tile art is requested at the width it's drawn on
+    // screen instead of the service's default.  this has to be set before
+    // the window is created
+    
+    m_sizedImages = sizedImages;
+}
+
+
+void DisneyWindow::setWebpImages(bool webpImages)
+{
+    // when on, tile art is requested as WebP, which the image service makes
+    // a good deal smaller than the JPEG for the same picture.  this has to be
+    // set before the window is created
+    
+    m_webpImages = webpImages;
+}
+
+
 bool DisneyWindow::onCreate()
 {
     // force the aspect ratio to 16:9, so we don't have to correct for items
@@ -43,18 +340,55 @@ bool DisneyWindow::onCreate()
     m_font.load("C:\\Windows\\Fonts\\Arial.ttf",20.0);
     
     
-    // request the main JSON file and parse it
-    const std::string url = "https://cd-static.bamgrid.com/dp-117731241344/home.json";
+    // keep a disk cache of everything we download next to the binary, so a
+    // warm start only has to revalidate.  if it can't be opened we just go to
+    // the network every time
+    m_cache.open(m_binaryPath + "cache");
+    m_supplicant.setCache(&m_cache);
+    m_supplicant.setCancellation(m_cancellation);
+    
+    if(m_textureCaching)
+        m_textureCache.open(m_binaryPath + "textures");
+    
+    
+    // BC1 is half the size of BC7 for opaque art, if the context has it
+    if(m_compressedTextures)
+    {
+        if(Texture::supports(Image::CompressionBc1))
+            m_textureCompression = Image::CompressionBc1;
+        else if(Texture::supports(Image::CompressionBc7))
+            m_textureCompression = Image::CompressionBc7;
+        
+        std::cout << "texture compression:  " << Image::name(m_textureCompression) << std::endl;
+    }
+    
+    
+    // if the last run left a snapshot of its catalog, the grid goes up from it
+    // right away.  the worker still fetches the catalog, and swaps it in once
+    // it's all there
+    if(m_snapshots)
+    {
+        double start = time();
+        
+        if(CatalogSnapshot::load(m_binaryPath + "catalog.snapshot",m_tileSets,m_tiles)  &&  !m_tileSets.empty())
+        {
+            m_bootstrapState = BootstrapReady;
+            m_warmStart = true;
+            
+            std::cout << "catalog snapshot:  " << m_tileSets.size() << " rows and " << m_tiles.size()
+                      << " tiles loaded in " << (time() - start) * 1000.0 << "ms" << std::endl;
+        }
+    }
     
-    m_supplicant.request(url);
     
-    nlohmann::json jsonHome = nlohmann::json::parse(m_supplicant.data());
-    parseStandardCollection(jsonHome["data"]["StandardCollection"],m_tileSets);
+    // work out the tile art width before the worker starts asking for it
+    updateImageWidth(width());
     
     
-    // create a worker thread to gather all of the images from the URLs we
-    // gathered while parsing the JSON
-    m_worker = std::thread(loadTextures,this);
+    // create a worker thread to request the main JSON file and everything it
+    // leads to.  we don't wait for any of it here, so the first frame goes up
+    // right away and the rows fill in as their data arrives
+    m_worker = std::thread(loadCatalog,this);
     
     
     // save the start time, and prime a few time variables with it
@@ -81,10 +415,37 @@ void DisneyWindow::onDestroy()
     m_selection.destroy();
     
     
+    // cancelling aborts whatever the worker has in flight, so it notices it's
+    // stopping within a few milliseconds rather than after its downloads
+    m_mutex.lock();
+    m_stopping = true;
+    m_cancellation.cancel();
+    m_workerCondition.notify_all();
+    m_mutex.unlock();
+    
     m_worker.join();
     
+    std::cout << "web cache:  " << m_cache.hits() << " hits, "
+              << m_cache.revalidations() << " revalidations, "
+              << m_cache.misses() << " misses" << std::endl;
+    
+    if(m_textureCache.valid())
+        std::cout << "texture cache:  " << m_textureCache.hits() << " hits, " << m_textureCache.misses() << " misses" << std::endl;
+    
+    std::cout << "tile art:  " << m_imageResidency.count() << " images in " << m_imageResidency.usage() << " bytes, "
+              << m_textureResidency.count() << " textures in " << m_textureResidency.usage() << " bytes, "
+              << m_encodedResidency.count() << " encoded in " << m_encodedResidency.usage() << " bytes" << std::endl;
+    
+    
+    // the worker is gone, so the rows are ours to save without the lock
+    if(m_snapshots  &&  m_bootstrapState == BootstrapReady)
+        CatalogSnapshot::save(m_binaryPath + "catalog.snapshot",m_tileSets,m_tiles);
     
     m_tileSets.clear();
+    m_tiles.clear();
+    m_retiredTextures.clear();
+    m_imageResidency.clear();
+    m_textureResidency.clear();
     
     
     m_font.destroy();
@@ -96,6 +457,14 @@ void DisneyWindow::onDestroy()
 
 void DisneyWindow::onKeyPress(int key)
 {
+    // the worker fills in rows while we're moving around, so hold the lock
+    // the whole time.  there's nothing to move around in until the grid is up
+    std::lock_guard<std::mutex> lock(m_mutex);
+    
+    if(m_bootstrapState != BootstrapReady  ||  m_tileSets.empty())
+        return;
+    
+    
     // save selection info, so we can easily tell if it changed
     int prevSelectionRow = m_selectionRow;
     int prevSelectionColumn = m_selectionColumn;
@@ -110,7 +479,7 @@ void DisneyWindow::onKeyPress(int key)
     {
         case GLFW_KEY_RIGHT:
             if(m_selectionColumn == 4)
-                m_tileSets[m_rowOffset + m_selectionRow].columnOffset = std::min((int) m_tileSets[m_rowOffset + m_selectionRow].tiles.size() - 1 - 4,m_tileSets[m_rowOffset + m_selectionRow].columnOffset + 1);
+                m_tileSets[m_rowOffset + m_selectionRow].columnOffset = std::max(0,std::min((int) m_tileSets[m_rowOffset + m_selectionRow].tiles.size() - 1 - 4,m_tileSets[m_rowOffset + m_selectionRow].columnOffset + 1));
             
             m_selectionColumn = std::min(4,m_selectionColumn + 1);
             break;
@@ -124,9 +493,9 @@ void DisneyWindow::onKeyPress(int key)
 
         case GLFW_KEY_DOWN:
             if(m_selectionRow == 3)
-                m_rowOffset = std::min((int) m_tileSets.size() - 1 - 3,m_rowOffset + 1);
+                m_rowOffset = std::max(0,std::min((int) m_tileSets.size() - 1 - 3,m_rowOffset + 1));
 
-            m_selectionRow = std::min(3,m_selectionRow + 1);
+            m_selectionRow = std::min(std::min(3,(int) m_tileSets.size() - 1 - m_rowOffset),m_selectionRow + 1);
             break;
         
         case GLFW_KEY_UP:
@@ -146,6 +515,15 @@ void DisneyWindow::onKeyPress(int key)
     {
         m_selectionChangeTime = m_currentTime;
     }
+    
+    
+    // if the view scrolled, let the worker know it may have more to request
+    if(prevRowOffset != m_rowOffset  ||
+       prevColumnOffset != m_tileSets[m_rowOffset + m_selectionRow].columnOffset)
+    {
+        m_viewportChanged = true;
+        m_workerCondition.notify_all();
+    }
 }
 
 
@@ -163,13 +541,44 @@ void DisneyWindow::onRender()
     ::glClear(GL_COLOR_BUFFER_BIT);
     
     
+    // grab what we need from the rows while holding the lock, since the worker
+    // may be filling them in.  textures the worker took off tiles that left
+    // the catalog are let go here, where there's a context to delete them in
+    m_mutex.lock();
+    
+    m_retiredTextures.clear();
+    
+    m_imageResidency.nextFrame();
+    m_textureResidency.nextFrame();
+    
+    BootstrapState bootstrapState = m_bootstrapState;
+    
+    updateImageWidth(width());
+    
+    if(bootstrapState == BootstrapReady  &&  !m_gridShown)
+    {
+        // the grid is going up for the first time, so treat it like the
+        // selection just changed
+        m_gridShown = true;
+        m_selectionChangeTime = m_currentTime;
+    }
+    
+    std::string videoUrl;
+    TileId selectedTile;
+    
+    if(tile(m_selectionRow,m_selectionColumn,selectedTile))
+        videoUrl = m_tiles.urlText(m_tiles.videoUrl(selectedTile));
+    
+    m_mutex.unlock();
+    
+    
     // if the selection just changed, then go ahead and try to open the new
     // video url
     if(m_selectionChangeTime == m_currentTime  &&
-       !m_tileSets[m_selectionRow + m_rowOffset].tiles[m_selectionColumn + m_tileSets[m_selectionRow + m_rowOffset].columnOffset].videoUrl.empty())
+       !videoUrl.empty())
     {
         m_decoder.close();
-        m_decoder.open(m_tileSets[m_selectionRow + m_rowOffset].tiles[m_selectionColumn + m_tileSets[m_selectionRow + m_rowOffset].columnOffset].videoUrl);
+        m_decoder.open(videoUrl);
         
         m_videoUpdateTime = m_currentTime;
     }
@@ -178,9 +587,9 @@ void DisneyWindow::onRender()
     m_currentTime = time();
     
     
-    // for the first 2 seconds we display the Disney+ logo to hide the loading
-    // of tile images
-    if(m_currentTime - m_startTime < 2.0)
+    // we display the Disney+ logo until the worker has the first rows ready,
+    // to hide the loading of the catalog
+    if(bootstrapState != BootstrapReady)
     {
         m_disneyPlusLogo.draw(0.0f,0.0f,1.0f,1.0f,
                               0.0f,0.0f,1.0f,1.0f);
@@ -192,7 +601,7 @@ void DisneyWindow::onRender()
         // and display the next frame
         if(m_currentTime - m_selectionChangeTime >= 3.0  &&
            m_currentTime >= m_videoUpdateTime  &&
-           !m_tileSets[m_selectionRow + m_rowOffset].tiles[m_selectionColumn + m_tileSets[m_selectionRow + m_rowOffset].columnOffset].videoUrl.empty())
+           !videoUrl.empty())
         {
             Image image;
             int result = m_decoder.decode(image);
@@ -200,14 +609,15 @@ void DisneyWindow::onRender()
             if(result < 0)
             {
                 m_decoder.close();
-                m_decoder.open(m_tileSets[m_selectionRow + m_rowOffset].tiles[m_selectionColumn + m_tileSets[m_selectionRow + m_rowOffset].columnOffset].videoUrl);
+                m_decoder.open(videoUrl);
                 
                 m_videoUpdateTime = m_currentTime;
             }
             else if(result > 0)
             {
-                m_videoFrame.destroy();
-                m_videoFrame.create(image);
+                // every frame is the same size, so it goes into the same
+                // texture
+                m_videoFrame.update(image);
                 
                 // these videos are all 24fps, so try to acheive that despite
                 // our 60fps framework
@@ -223,20 +633,34 @@ void DisneyWindow::onRender()
         float tileHeight = 2.0f / rowCount;
         
         m_mutex.lock();
-        for(int row = 0;row < (int) rowCount;++row)
+        for(int row = 0;row < (int) rowCount  &&  row + m_rowOffset < (int) m_tileSets.size();++row)
         {
+            TileSet& tileSet = m_tileSets[row + m_rowOffset];
+            
+            
             // draw the text caption for each row/tile set
-            m_font.drawText(m_tileSets[row + m_rowOffset].name,
+            m_font.drawText(tileSet.name,
                             -1.0f + tileWidth * 0.13f,1.0f - tileHeight * row - tileHeight * 0.125f,0.5f,0.1f);
             
             
             for(int column = 0;column < (int) columnCount + 1;++column)
             {
-                // if we're trying to draw the half tile at the right of the
-                // row but it doesn't exit, just bail out
-                if(column == 5  &&  m_tileSets[row + m_rowOffset].columnOffset == (int) m_tileSets[row + m_rowOffset].tiles.size() - 1 - 4)
+                // if we're trying to draw past the end of the row, just bail
+                // out.  a row that is still loading has no tiles yet, so we
+                // fill it with placeholders instead
+                TileId currentTile = 0;
+                bool tileShown = tile(row,column,currentTile);
+                
+                if(!tileShown  &&  tileSet.loaded)
                     break;
                 
+                UrlId url = m_tiles.url(currentTile);
+                
+                // find() rather than [], so tiles whose art hasn't come in
+                // yet aren't given an entry that says it has
+                auto widthIndex = m_imageWidths.find(url);
+                int imageWidth = widthIndex != m_imageWidths.end() ? widthIndex->second : 0;
+                
                 
                 // draw all of the tiles at 90% of the grid width and height,
                 // except the selected tile, which is 95%
@@ -248,44 +672,83 @@ void DisneyWindow::onRender()
                 }
                 
                 
+                // if a sharper image has come in since the texture was made,
+                // drop the texture so it's made again from the new image
+                if(tileShown  &&  m_tiles.texture(currentTile)  &&
+                   m_tiles.textureWidth(currentTile) < imageWidth)
+                {
+                    m_tiles.setTexture(currentTile,std::shared_ptr<Texture>(),0);
+                    m_textureResidency.erase(currentTile);
+                }
+                
+                // whatever is on screen is kept this frame
+                if(tileShown  &&  m_tiles.texture(currentTile))
+                    m_textureResidency.use(currentTile,m_tiles.texture(currentTile)->size());
+                
+                
                 // if this is the selected tile, the video url is valid, and
                 // it's been 3 seconds since it was selected, then draw the
                 // current video frame
-                if(row == m_selectionRow  &&  column == m_selectionColumn  &&
-                   !m_tileSets[m_selectionRow + m_rowOffset].tiles[m_selectionColumn + m_tileSets[m_selectionRow + m_rowOffset].columnOffset].videoUrl.empty()  &&
+                if(tileShown  &&
+                   row == m_selectionRow  &&  column == m_selectionColumn  &&
+                   m_tiles.videoUrl(currentTile)  &&
                    m_currentTime - m_selectionChangeTime >= 3.0)
                 {
                     m_videoFrame.draw(-1.0f + tileWidth * column + tileWidth * 0.6f,1.0f - tileHeight * row - tileHeight * 0.5f,tileWidth * scale,tileWidth * scale,
                                       0.0f,0.0f,1.0f,1.0f);
                 }
                 // if the texture for this tile exists, then draw it
-                else if(m_tileSets[row + m_rowOffset].tiles[column + m_tileSets[row + m_rowOffset].columnOffset].texture)
+                else if(tileShown  &&  m_tiles.texture(currentTile))
                 {
-                    m_tileSets[row + m_rowOffset].tiles[column + m_tileSets[row + m_rowOffset].columnOffset].texture->draw(-1.0f + tileWidth * column + tileWidth * 0.6f,1.0f - tileHeight * row - tileHeight * 0.5f,tileWidth * scale,tileWidth * scale,
-                                                                0.0f,0.0f,1.0f,1.0f);
+                    m_tiles.texture(currentTile)->draw(-1.0f + tileWidth * column + tileWidth * 0.6f,1.0f - tileHeight * row - tileHeight * 0.5f,tileWidth * scale,tileWidth * scale,
+                                                       0.0f,0.0f,1.0f,1.0f);
                 }
                 // if the image for this tile has been loaded, then create a
                 // texture for it
-                else if(m_images.find(m_tileSets[row + m_rowOffset].tiles[column + m_tileSets[row + m_rowOffset].columnOffset].url) != m_images.end())
+                else if(tileShown  &&  m_images.find(url) != m_images.end())
                 {
                     std::shared_ptr<Texture> texture = std::make_shared<Texture>();
                     
-                    if(texture->create(*m_images[m_tileSets[row + m_rowOffset].tiles[column + m_tileSets[row + m_rowOffset].columnOffset].url]))
+                    if(texture->create(*m_images[url]))
                     {
-                        m_tileSets[row + m_rowOffset].tiles[column + m_tileSets[row + m_rowOffset].columnOffset].texture = std::move(texture);
-                        m_tileSets[row + m_rowOffset].tiles[column + m_tileSets[row + m_rowOffset].columnOffset].texture->draw(-1.0f + tileWidth * column + tileWidth * 0.6f,1.0f - tileHeight * row - tileHeight * 0.5f,tileWidth * scale,tileWidth * scale,
-                                                                    0.0f,0.0f,1.0f,1.0f);
+                        m_tiles.setTexture(currentTile,texture,imageWidth);
+                        m_textureResidency.use(currentTile,texture->size());
+                        texture->draw(-1.0f + tileWidth * column + tileWidth * 0.6f,1.0f - tileHeight * row - tileHeight * 0.5f,tileWidth * scale,tileWidth * scale,
+                                      0.0f,0.0f,1.0f,1.0f);
                     }
                 }
                 // if everything else failed, then draw the Disney+ logo for
-                // this tile
+                // this tile.  if its art was let go of to stay in budget, the
+                // worker is woken to load it again
                 else
                 {
+                    if(tileShown  &&  m_imageWidths.erase(url))
+                    {
+                        m_viewportChanged = true;
+                        m_workerCondition.notify_all();
+                    }
+                    
                     m_disneyPlusLogo.draw(-1.0f + tileWidth * column + tileWidth * 0.6f,1.0f - tileHeight * row - tileHeight * 0.5f,tileWidth * scale,tileWidth * scale,
                                           0.0f,0.0f,1.0f,1.0f);
                 }
             }
         }
+        
+        
+        // let go of what was drawn or decoded least recently until we're back
+        // in budget.  nothing drawn this frame goes, and an image that's been
+        // made into a texture is just a copy, so it soon ages out
+        uint32_t key;
+        
+        while(m_textureResidency.evict(key))
+        {
+            if(key < m_tiles.size())
+                m_tiles.setTexture(key,std::shared_ptr<Texture>(),0);
+        }
+        
+        while(m_imageResidency.evict(key))
+            m_images.erase(key);
+        
         m_mutex.unlock();
     }
     
@@ -294,111 +757,1020 @@ void DisneyWindow::onRender()
 }
 
 
-void DisneyWindow::parseStandardCollection(nlohmann::json& standardCollection,std::vector<TileSet>& tileSets)
+bool DisneyWindow::tile(int row,int column,TileId& id) const
 {
-    // this function will be called with a StandardCollection object, not its
-    // parent object
+    // look up a tile by its position in the on-screen grid.  this returns
+    // false if there's nothing there, which happens past the end of a row or
+    // while a row is still loading.  the caller must hold the lock
     
-    auto containers = standardCollection["containers"];
+    row += m_rowOffset;
     
-    for(int index = 0;index < containers.size();++index)
-    {
-        if(containers[index]["set"]["type"].get<std::string>() == "SetRef")
-        {
-            // if the set is a SetRef, then retrieve its JSON and parse it asctime
-            // a normal set
-            
-            std::string refId = containers[index]["set"]["refId"].get<std::string>();
-            std::string url = std::string("https://cd-static.bamgrid.com/dp-117731241344/sets/") + refId + ".json";
-            
-            m_supplicant.request(url);
-            
-            
-            nlohmann::json jsonRefSet = nlohmann::json::parse(m_supplicant.data());
-            
-            if(!jsonRefSet.contains("data"))
-                return;
-            
-            parseSet(jsonRefSet["data"].front(),tileSets);
-        }
-        else
-        {
-            // this is just a normal set, so parse it
-            
-            parseSet(containers[index]["set"],tileSets);
-        }
-    }
+    if(row < 0  ||  row >= (int) m_tileSets.size())
+        return false;
+    
+    column += m_tileSets[row].columnOffset;
+    
+    if(column < 0  ||  column >= (int) m_tileSets[row].tiles.size())
+        return false;
+    
+    id = m_tileSets[row].tiles[column];
+    return true;
 }
 
 
-void DisneyWindow::parseSet(nlohmann::json& set,std::vector<TileSet>& tileSets)
+void DisneyWindow::loadCatalog(DisneyWindow *object)
 {
-    // this function will be called with a set object, not its parent object
+    // this function will run in a separate thread.  it requests the main JSON
+    // file and publishes a row for each of its containers, then resolves the
+    // SetRef rows and retrieves the tile images concurrently, filling the rows
+    // in as fast as the data arrives
+    
+    const std::string url = homeUrl;
+    
+    std::vector<TileSet> tileSets;
+    TileTable tiles;
+    
+    // the document goes to the parser as it downloads
+    std::shared_ptr<CatalogParser> parser = CatalogParser::create(object->m_parserBackend,CatalogParser::HomeDocument);
+    
+    object->m_supplicant.setSink(parserSink(parser));
+    
+    if(object->m_supplicant.request(url)  &&  parser->finish())
+        tileSets = parser->takeTileSets(tiles);
+    
+    object->m_supplicant.setSink(WebSupplicant::Sink());
+    
+    if(object->m_cancellation.cancelled())
+        return;
+    
+    // when we started from a snapshot, it's already on screen.  we carry on
+    // with it if the catalog can't be loaded, which means we work offline
+    bool warmStart = object->m_warmStart;
+    
+    if(tileSets.empty())
+    {
+        std::cerr << "DisneyWindow::loadCatalog:  error loading '" << url << "'" << std::endl;
+        
+        if(!warmStart)
+        {
+            object->m_mutex.lock();
+            object->m_bootstrapState = BootstrapFailed;
+            object->m_mutex.unlock();
+            return;
+        }
+    }
+    
+    
+    // keep track of how much came over the network against how much it
+    // decoded to, to see what compression is buying us
+    long long wireBytes = object->m_supplicant.wireBytes();
+    long long decodedBytes = object->m_supplicant.decodedBytes();
     
-    TileSet tileSet;
-    tileSet.name = set["text"]["title"]["full"]["set"]["default"]["content"].get<std::string>();
-    tileSet.columnOffset = 0;
     
-    auto items = set["items"];
+    WebDispatcher dispatcher;
+    dispatcher.setCache(&object->m_cache);
+    dispatcher.setCancellation(object->m_cancellation);
     
-    for(int index = 0;index < items.size();++index)
+    std::unordered_map<std::string,std::string> setUrls;
+    std::unordered_map<std::string,std::shared_ptr<CatalogParser>> setParsers;
+    std::unordered_map<std::string,std::pair<UrlId,int>> imageUrls;
+    std::unordered_set<std::string> failed;
+    std::unordered_set<std::string> decoding;
+    std::vector<std::string> encodedUrls;
+    
+    int decodedImages = 0;
+    long long decodedPixelBytes = 0;
+    double decodeTime = 0.0;
+    
+    
+    // images are decoded off this thread, and go into the grid as soon as
+    // they're done.  one thread is left for this one and one for rendering.
+    // if the table's urls were renumbered while an image was being decoded,
+    // its id is stale, so it's left for us to store when it comes back
+    DecodePool decodePool;
+    
+    decodePool.setTextureCache(object->m_textureCache.valid() ? &object->m_textureCache : nullptr);
+    decodePool.setCompression(object->m_textureCompression);
+    decodePool.setCompletion([object](DecodePool::Job& job)
     {
-        Tile tile;
-        tile.name = items[index]["text"]["title"]["full"].front()["default"]["content"].get<std::string>();
+        if(!job.image)
+            return;
         
-        if(!items[index]["ratings"][0]["value"].is_null())
-            tile.rating = items[index]["ratings"][0]["value"].get<std::string>();
+        std::lock_guard<std::mutex> lock(object->m_mutex);
         
-        if(!items[index]["releases"][0]["releaseDate"].is_null())
-            tile.releaseDate = items[index]["releases"][0]["releaseDate"].get<std::string>();
+        if(job.generation != object->m_urlGeneration)
+            return;
+        
+        object->storeImage(job.id,job.width,job.image);
+        job.stored = true;
+    });
+    
+    int decodeThreads = std::max(1,(int) std::thread::hardware_concurrency() - 2);
+    decodePool.start(decodeThreads,decodeThreads * 2);
+    
+    
+    // a refresh fetches the home document again, then the sets of the rows
+    // we already have loaded.  the new rows are kept to one side in tileSets
+    // until all of their sets are in, then applied together, so the grid
+    // never drops back to empty rows.  meanwhile the rows on screen carry on
+    // loading.  starting from a snapshot is a refresh that begins straight
+    // away, at the priority of what's on screen
+    std::shared_ptr<CatalogParser> homeParser;
+    std::unordered_set<std::string> refreshUrls;
+    WebDispatcher::Priority refreshPriority = WebDispatcher::PriorityPrefetch;
+    
+    double refreshInterval = object->m_refreshInterval;
+    std::chrono::steady_clock::time_point nextRefresh = secondsFromNow(refreshInterval);
+    
+    object->m_mutex.lock();
+    
+    if(!warmStart)
+    {
+        object->m_tileSets = std::move(tileSets);
+        object->m_tiles.swap(tiles);
+        object->m_bootstrapState = BootstrapRows;
+        object->updateBootstrapState();
         
-        tile.url = items[index]["image"]["tile"]["1.78"].front()["default"]["url"].get<std::string>();
+        tileSets.clear();
+        tiles.clear();
+    }
+    else if(!tileSets.empty())
+    {
+        refreshPriority = WebDispatcher::PriorityVisible;
         
-        if(items[index]["videoArt"].size())
-            tile.videoUrl = items[index]["videoArt"][0]["mediaMetadata"]["urls"][0]["url"].get<std::string>();
+        object->requestRefresh(dispatcher,tileSets,setUrls,setParsers,refreshUrls,refreshPriority);
         
-        tileSet.tiles.push_back(tile);
+        if(refreshUrls.empty())
+            object->applyCatalog(tileSets,tiles,imageUrls);
     }
     
-    tileSets.push_back(tileSet);
-}
-
-
-void DisneyWindow::loadTextures(DisneyWindow *object)
-{
-    // this function will run in a separate thread, and it will retrieve the
-    // tile images as fast as it can then finish
+    object->m_mutex.unlock();
     
-    WebSupplicant supplicant;
-    int rowCount = (int) object->m_tileSets.size();
     
-    for(int row = 0;row < rowCount;++row)
+    // sets and images come back in whatever order they finish.  a set fills
+    // in every row that refers to it, and whenever that happens or the view
+    // moves we go looking for more to request
+    WebDispatcher::Response response;
+    bool changed = true;
+    
+    while(true)
     {
-        int columnCount = (int) object->m_tileSets[row].tiles.size();
+        object->m_mutex.lock();
         
-        for(int column = 0;column < columnCount;++column)
+        if(object->m_stopping)
         {
-            object->m_mutex.lock();
-            auto imageIndex = object->m_images.find(object->m_tileSets[row].tiles[column].url);
             object->m_mutex.unlock();
+            break;
+        }
+        
+        // a refresh only starts once the grid is up and the last one is done.
+        // images that failed get another try with it
+        if(refreshInterval > 0.0  &&  !homeParser  &&  refreshUrls.empty()  &&
+           object->m_bootstrapState == BootstrapReady  &&
+           std::chrono::steady_clock::now() >= nextRefresh)
+        {
+            homeParser = CatalogParser::create(object->m_parserBackend,CatalogParser::HomeDocument);
+            refreshPriority = WebDispatcher::PriorityPrefetch;
+            failed.clear();
             
-            if(imageIndex == object->m_images.end())
+            changed = true;
+        }
+        
+        if(changed  ||  object->m_viewportChanged)
+        {
+            // when the view moves, everything pending sinks to the bottom and
+            // whatever is still wanted gets requested again at its priority
+            // for the new view.  when loading lazily, whatever is left at the
+            // bottom has scrolled out of range and is dropped
+            if(object->m_viewportChanged)
+                dispatcher.demote(WebDispatcher::PriorityBackground);
+            
+            object->requestData(dispatcher,failed,decoding,setUrls,setParsers,imageUrls,encodedUrls);
+            
+            if(homeParser)
+                dispatcher.stream(url,parserSink(homeParser),refreshPriority);
+            
+            for(const std::string& setRequestUrl : refreshUrls)
+                dispatcher.stream(setRequestUrl,parserSink(setParsers[setRequestUrl]),refreshPriority);
+            
+            if(object->m_viewportChanged  &&  object->m_lazyLoading)
+                dispatcher.cancel(WebDispatcher::PriorityBackground);
+            
+            object->m_viewportChanged = false;
+            changed = false;
+        }
+        
+        
+        // art we hold encoded that's come near the screen goes straight to
+        // the decoders, with a copy of its bytes
+        std::vector<DecodePool::Job> encodedJobs;
+        
+        for(const std::string& encodedUrl : encodedUrls)
+        {
+            const std::pair<UrlId,int>& image = imageUrls[encodedUrl];
+            
+            DecodePool::Job job;
+            job.url = encodedUrl;
+            job.data = object->m_encodedImages[image.first].first;
+            job.id = image.first;
+            job.width = image.second;
+            job.decodeWidth = object->m_scaledDecoding ? job.width : 0;
+            job.generation = object->m_urlGeneration;
+            
+            encodedJobs.push_back(std::move(job));
+        }
+        
+        encodedUrls.clear();
+        
+        object->m_mutex.unlock();
+        
+        for(DecodePool::Job& job : encodedJobs)
+        {
+            decoding.insert(job.url);
+            decodePool.submit(job);
+        }
+        
+        
+        // take back the images that have been decoded.  one that couldn't be
+        // isn't asked for again, and the buffer goes back to the dispatcher
+        // for the next download
+        DecodePool::Job decoded;
+        
+        while(decodePool.next(decoded))
+        {
+            decoding.erase(decoded.url);
+            decodeTime += decoded.decodeTime;
+            
+            if(decoded.image)
+            {
+                ++decodedImages;
+                decodedPixelBytes += (long long) decoded.image->width() * decoded.image->height() * decoded.image->bitsPerPixel() / 8;
+            }
+            
+            auto imageIndex = imageUrls.find(decoded.url);
+            
+            if(!decoded.image)
+            {
+                failed.insert(decoded.url);
+            }
+            else if(!decoded.stored  &&  imageIndex != imageUrls.end())
+            {
+                object->m_mutex.lock();
+                object->storeImage(imageIndex->second.first,imageIndex->second.second,decoded.image);
+                object->m_mutex.unlock();
+            }
+            
+            if(imageIndex != imageUrls.end())
+                imageUrls.erase(imageIndex);
+            
+            WebDispatcher::Response spent;
+            spent.data.swap(decoded.data);
+            dispatcher.recycle(spent);
+        }
+        
+        
+        // when the decoders are full, or all that's left is decoding, wait on
+        // them rather than the network.  the transfers in flight back up
+        // meanwhile, so downloads never run further ahead than the decoders
+        if(decodePool.full()  ||  (!dispatcher.pending()  &&  decodePool.pending()))
+        {
+            decodePool.wait(50);
+            continue;
+        }
+        
+        
+        // with nothing in flight we're done, unless we're loading lazily or
+        // on a memory budget, in which case we sleep until the view moves or
+        // art has to be loaded again, or refreshing, in which case we sleep
+        // until the next refresh at the latest
+        if(!dispatcher.pending())
+        {
+            if(!object->m_lazyLoading  &&  refreshInterval <= 0.0  &&
+               object->m_imageResidency.budget() == 0  &&  object->m_textureResidency.budget() == 0  &&
+               object->m_encodedResidency.budget() == 0)
+                break;
+            
+            std::unique_lock<std::mutex> lock(object->m_mutex);
+            auto woken = [object]() { return object->m_viewportChanged  ||  object->m_stopping; };
+            
+            if(refreshInterval > 0.0)
+                object->m_workerCondition.wait_until(lock,nextRefresh,woken);
+            else
+                object->m_workerCondition.wait(lock,woken);
+            
+            continue;
+        }
+        
+        if(!dispatcher.next(response,50))
+            continue;
+        
+        wireBytes += response.wireBytes;
+        decodedBytes += response.decodedBytes;
+        
+        
+        auto setIndex = setUrls.find(response.url);
+        
+        if(homeParser  &&  response.url == url)
+        {
+            // the home document has come in again.  the sets of the rows
+            // that are loaded now are fetched again with it, and if there
+            // aren't any the new rows are applied right away
+            if(response.success  &&  homeParser->finish())
+                tileSets = homeParser->takeTileSets(tiles);
+            
+            homeParser.reset();
+            
+            object->m_mutex.lock();
+            
+            if(!tileSets.empty())
+            {
+                object->requestRefresh(dispatcher,tileSets,setUrls,setParsers,refreshUrls,refreshPriority);
+                
+                if(refreshUrls.empty())
+                    object->applyCatalog(tileSets,tiles,imageUrls);
+            }
+            else
+            {
+                std::cerr << "DisneyWindow::loadCatalog:  error refreshing '" << url << "'" << std::endl;
+                
+                tiles.clear();
+            }
+            
+            object->m_mutex.unlock();
+            
+            if(refreshUrls.empty())
+                nextRefresh = secondsFromNow(refreshInterval);
+            
+            changed = true;
+        }
+        else if(setIndex != setUrls.end())
+        {
+            std::vector<TileSet> refSets;
+            TileTable refTiles;
+            
+            auto parserIndex = setParsers.find(response.url);
+            
+            if(parserIndex != setParsers.end())
+            {
+                if(response.success  &&  parserIndex->second->finish())
+                    refSets = parserIndex->second->takeTileSets(refTiles);
+                else if(response.success)
+                    std::cerr << "DisneyWindow::loadCatalog:  error parsing '" << response.url << "'" << std::endl;
+                
+                setParsers.erase(parserIndex);
+            }
+            
+            const TileSet *refSet = refSets.empty() ? nullptr : &refSets.front();
+            
+            object->m_mutex.lock();
+            
+            object->resolveSetRef(setIndex->second,refSet,refTiles);
+            object->updateBootstrapState();
+            
+            // the rows of a refresh are filled in too, and applied with the
+            // last of their sets
+            bool refreshed = false;
+            
+            if(refreshUrls.erase(response.url))
+            {
+                if(refSet)
+                    fillRows(tileSets,tiles,setIndex->second,*refSet,refTiles);
+                
+                if(refreshUrls.empty())
+                {
+                    object->applyCatalog(tileSets,tiles,imageUrls);
+                    refreshed = true;
+                }
+            }
+            
+            object->m_mutex.unlock();
+            
+            if(refreshed)
+                nextRefresh = secondsFromNow(refreshInterval);
+            
+            changed = true;
+        }
+        else
+        {
+            // images are kept under the tile's own url, whatever size was
+            // asked for
+            auto imageIndex = imageUrls.find(response.url);
+            
+            if(imageIndex == imageUrls.end())
+            {
+                dispatcher.recycle(response);
+                continue;
+            }
+            
+            if(!response.success)
             {
-                if(supplicant.request(object->m_tileSets[row].tiles[column].url))
+                imageUrls.erase(imageIndex);
+                failed.insert(response.url);
+                
+                dispatcher.recycle(response);
+                continue;
+            }
+            
+            
+            // when holding art encoded, the body is kept, and decoded now only
+            // if its tile is near the screen
+            object->m_mutex.lock();
+            
+            bool decodeNow = true;
+            
+            if(object->m_encodedResidency.budget() > 0)
+            {
+                object->storeEncoded(imageIndex->second.first,imageIndex->second.second,response.data);
+                decodeNow = object->nearViewport(imageIndex->second.first);
+            }
+            
+            unsigned generation = object->m_urlGeneration;
+            bool scaledDecoding = object->m_scaledDecoding;
+            
+            object->m_mutex.unlock();
+            
+            if(!decodeNow)
+            {
+                imageUrls.erase(imageIndex);
+                
+                dispatcher.recycle(response);
+                continue;
+            }
+            
+            
+            // the body is handed to the decoders, and its buffer comes back
+            // with the decoded image
+            DecodePool::Job job;
+            job.url = response.url;
+            job.data.swap(response.data);
+            job.id = imageIndex->second.first;
+            job.width = imageIndex->second.second;
+            job.decodeWidth = scaledDecoding ? job.width : 0;
+            job.generation = generation;
+            
+            decoding.insert(response.url);
+            decodePool.submit(job);
+            continue;
+        }
+        
+        
+        // give the buffer back to the dispatcher for the next download
+        dispatcher.recycle(response);
+    }
+    
+    object->m_mutex.lock();
+    
+    std::cout << "worker thread finished:  " << wireBytes << " bytes transferred, "
+              << decodedBytes << " bytes decoded, " << object->m_tiles.size() << " tiles and "
+              << object->m_tiles.urlCount() << " urls in " << object->m_tiles.memoryUsage() << " bytes" << std::endl;
+    
+    std::cout << "images decoded:  " << decodedImages << " images, " << decodedPixelBytes << " bytes of pixels, "
+              << decodeTime * 1000.0 << "ms decoding" << std::endl;
+    
+    object->m_mutex.unlock();
+}
+
+
+void DisneyWindow::resolveSetRef(const std::string& refId,const TileSet *tileSet,const TileTable& tiles)
+{
+    // fill in every row waiting on this refId.  if the set couldn't be loaded
+    // then its rows are dropped, keeping the offsets and selection in range.
+    // the caller must hold the lock
+    
+    if(tileSet)
+    {
+        fillRows(m_tileSets,m_tiles,refId,*tileSet,tiles);
+        return;
+    }
+    
+    
+    for(int row = 0;row < (int) m_tileSets.size();)
+    {
+        if(m_tileSets[row].loaded  ||  m_tileSets[row].refId != refId)
+        {
+            ++row;
+            continue;
+        }
+        
+        m_tileSets.erase(m_tileSets.begin() + row);
+        
+        m_rowOffset = std::max(0,std::min((int) m_tileSets.size() - 1 - 3,m_rowOffset));
+        m_selectionRow = std::max(0,std::min((int) m_tileSets.size() - 1 - m_rowOffset,m_selectionRow));
+    }
+}
+
+
+void DisneyWindow::applyCatalog(std::vector<TileSet>& tileSets,TileTable& tiles,std::unordered_map<std::string,std::pair<UrlId,int>>& imageUrls)
+{
+    // bring the rows up to date with ones from a newer catalog, changing only
+    // what's different.  a tile that hasn't changed keeps its id, and with it
+    // its texture and image.  a new tile is added to our table, and takes over
+    // the texture of a tile with the same art that's in no row any more.  a
+    // texture is never held by two tiles, so the texture budget counts it once
+    // and evicting it frees it.  tiles that are in no row any more give up
+    // their textures and images, and once they make up most of the table it's
+    // packed down.  tileSets and tiles are left empty for the
+    // next refresh.  the caller must hold the lock
+    
+    std::unordered_map<std::string,TileId> currentTiles;
+    std::unordered_map<UrlId,std::vector<TileId>> addedTiles;
+    
+    for(TileId id = 0;id < (TileId) m_tiles.size();++id)
+        currentTiles.emplace(tileKey(m_tiles,id),id);
+    
+    std::unordered_map<std::string,const TileSet *> currentRows;
+    std::vector<bool> wasShown(m_tiles.size(),false);
+    
+    for(const TileSet& tileSet : m_tileSets)
+    {
+        currentRows.emplace(rowKey(tileSet),&tileSet);
+        
+        for(TileId id : tileSet.tiles)
+            wasShown[id] = true;
+    }
+    
+    std::string selectedRow;
+    
+    if(m_rowOffset + m_selectionRow < (int) m_tileSets.size())
+        selectedRow = rowKey(m_tileSets[m_rowOffset + m_selectionRow]);
+    
+    
+    int kept = 0;
+    int added = 0;
+    
+    for(TileSet& tileSet : tileSets)
+    {
+        auto rowIndex = currentRows.find(rowKey(tileSet));
+        const TileSet *currentRow = rowIndex == currentRows.end() ? nullptr : rowIndex->second;
+        
+        // a set that couldn't be fetched again keeps the tiles it had
+        if(!tileSet.loaded  &&  currentRow  &&  currentRow->loaded)
+        {
+            tileSet.tiles = currentRow->tiles;
+            tileSet.loaded = true;
+            
+            kept += (int) tileSet.tiles.size();
+        }
+        else
+        {
+            for(TileId& id : tileSet.tiles)
+            {
+                std::string key = tileKey(tiles,id);
+                auto tileIndex = currentTiles.find(key);
+                
+                if(tileIndex != currentTiles.end())
                 {
-                    std::string data = supplicant.data();
+                    id = tileIndex->second;
+                    ++kept;
+                    continue;
+                }
                 
-                    std::shared_ptr<Image> image = std::make_shared<Image>();
-                    if(image->load((unsigned char *) data.data(),(int) data.size()))
-                    {
-                        object->m_mutex.lock();
-                        object->m_images[object->m_tileSets[row].tiles[column].url] = std::move(image);
-                        object->m_mutex.unlock();
-                    }
+                TileId newId = m_tiles.add(tiles,id);
+                addedTiles[m_tiles.url(newId)].push_back(newId);
+                
+                currentTiles.emplace(std::move(key),newId);
+                id = newId;
+                ++added;
+            }
+        }
+        
+        if(currentRow)
+            tileSet.columnOffset = std::max(0,std::min((int) tileSet.tiles.size() - 1 - 4,currentRow->columnOffset));
+    }
+    
+    
+    // let go of whatever is no longer shown.  a texture goes to a new tile
+    // with the same art if there is one.  otherwise it's only deleted on the
+    // render thread, so it's handed over to that
+    std::vector<bool> shown(m_tiles.size(),false);
+    std::unordered_set<UrlId> shownUrls;
+    int shownCount = 0;
+    int dropped = 0;
+    
+    for(const TileSet& tileSet : tileSets)
+    {
+        for(TileId id : tileSet.tiles)
+        {
+            if(shown[id])
+                continue;
+            
+            shown[id] = true;
+            shownUrls.insert(m_tiles.url(id));
+            ++shownCount;
+        }
+    }
+    
+    for(TileId id = 0;id < (TileId) m_tiles.size();++id)
+    {
+        if(shown[id])
+            continue;
+        
+        if(id < (TileId) wasShown.size()  &&  wasShown[id])
+            ++dropped;
+        
+        if(m_tiles.texture(id))
+        {
+            auto added = addedTiles.find(m_tiles.url(id));
+            
+            if(added != addedTiles.end()  &&  !added->second.empty())
+            {
+                m_tiles.setTexture(added->second.back(),m_tiles.texture(id),m_tiles.textureWidth(id));
+                added->second.pop_back();
+            }
+            else
+            {
+                m_retiredTextures.push_back(m_tiles.texture(id));
+            }
+            
+            m_tiles.setTexture(id,std::shared_ptr<Texture>(),0);
+            m_textureResidency.erase(id);
+        }
+    }
+    
+    for(auto image = m_images.begin();image != m_images.end();)
+    {
+        if(shownUrls.find(image->first) == shownUrls.end())
+        {
+            m_imageResidency.erase(image->first);
+            image = m_images.erase(image);
+        }
+        else
+            ++image;
+    }
+    
+    for(auto imageWidth = m_imageWidths.begin();imageWidth != m_imageWidths.end();)
+    {
+        if(shownUrls.find(imageWidth->first) == shownUrls.end())
+            imageWidth = m_imageWidths.erase(imageWidth);
+        else
+            ++imageWidth;
+    }
+    
+    for(auto encoded = m_encodedImages.begin();encoded != m_encodedImages.end();)
+    {
+        if(shownUrls.find(encoded->first) == shownUrls.end())
+        {
+            m_encodedResidency.erase(encoded->first);
+            encoded = m_encodedImages.erase(encoded);
+        }
+        else
+        {
+            ++encoded;
+        }
+    }
+    
+    for(auto imageUrl = imageUrls.begin();imageUrl != imageUrls.end();)
+    {
+        if(shownUrls.find(imageUrl->second.first) == shownUrls.end())
+            imageUrl = imageUrls.erase(imageUrl);
+        else
+            ++imageUrl;
+    }
+    
+    
+    // tile ids are never reused, so over many refreshes the table fills up
+    // with tiles nothing shows.  when they're the most of it, the tiles that
+    // are shown are copied to a new table, textures and all, and everything
+    // keyed by their ids or urls moves over
+    if(m_tiles.size() > 2 * (size_t) shownCount + 256)
+    {
+        TileTable packed;
+        std::unordered_map<TileId,TileId> ids;
+        std::unordered_map<UrlId,UrlId> urls;
+        
+        for(TileSet& tileSet : tileSets)
+        {
+            for(TileId& id : tileSet.tiles)
+            {
+                auto idIndex = ids.find(id);
+                
+                if(idIndex == ids.end())
+                {
+                    TileId packedId = packed.add(m_tiles,id);
+                    
+                    urls[m_tiles.url(id)] = packed.url(packedId);
+                    idIndex = ids.emplace(id,packedId).first;
+                }
+                
+                id = idIndex->second;
+            }
+        }
+        
+        std::unordered_map<UrlId,std::shared_ptr<Image>> images;
+        std::unordered_map<UrlId,int> imageWidths;
+        std::unordered_map<UrlId,std::pair<std::string,int>> encodedImages;
+        
+        for(auto& image : m_images)
+            images[urls[image.first]] = std::move(image.second);
+        
+        for(const auto& imageWidth : m_imageWidths)
+            imageWidths[urls[imageWidth.first]] = imageWidth.second;
+        
+        for(auto& encoded : m_encodedImages)
+            encodedImages[urls[encoded.first]] = std::move(encoded.second);
+        
+        for(auto& imageUrl : imageUrls)
+            imageUrl.second.first = urls[imageUrl.second.first];
+        
+        m_tiles.swap(packed);
+        m_images.swap(images);
+        m_imageWidths.swap(imageWidths);
+        m_encodedImages.swap(encodedImages);
+        m_imageResidency.remap(urls);
+        m_encodedResidency.remap(urls);
+        m_textureResidency.remap(ids);
+        
+        ++m_urlGeneration;
+    }
+    
+    
+    // keep the selected row where it is on screen, if it's still there
+    m_tileSets.swap(tileSets);
+    
+    for(int row = 0;row < (int) m_tileSets.size();++row)
+    {
+        if(rowKey(m_tileSets[row]) == selectedRow)
+        {
+            m_rowOffset = row - m_selectionRow;
+            break;
+        }
+    }
+    
+    m_rowOffset = std::max(0,std::min((int) m_tileSets.size() - 1 - 3,m_rowOffset));
+    m_selectionRow = std::max(0,std::min((int) m_tileSets.size() - 1 - m_rowOffset,m_selectionRow));
+    
+    tileSets.clear();
+    tiles.clear();
+    
+    std::cout << "catalog refresh:  " << m_tileSets.size() << " rows, " << kept << " tiles kept, "
+              << added << " added, " << dropped << " dropped" << std::endl;
+}
+
+
+void DisneyWindow::requestRefresh(WebDispatcher& dispatcher,const std::vector<TileSet>& tileSets,std::unordered_map<std::string,std::string>& setUrls,std::unordered_map<std::string,std::shared_ptr<CatalogParser>>& setParsers,std::unordered_set<std::string>& refreshUrls,WebDispatcher::Priority refreshPriority)
+{
+    // fetch the sets of new rows that stand in for rows we have loaded, since
+    // their contents may have changed.  any other row is left unloaded, to
+    // be requested like a new one once the rows are applied.  the caller
+    // must hold the lock
+    
+    std::unordered_set<std::string> loaded;
+    
+    for(const TileSet& tileSet : m_tileSets)
+    {
+        if(tileSet.loaded  &&  !tileSet.refId.empty())
+            loaded.insert(tileSet.refId);
+    }
+    
+    for(const TileSet& tileSet : tileSets)
+    {
+        if(tileSet.loaded  ||  loaded.find(tileSet.refId) == loaded.end())
+            continue;
+        
+        std::string url = setUrl(tileSet.refId);
+        
+        std::shared_ptr<CatalogParser>& parser = setParsers[url];
+        
+        if(!parser)
+            parser = CatalogParser::create(m_parserBackend,CatalogParser::SetDocument);
+        
+        setUrls[url] = tileSet.refId;
+        refreshUrls.insert(url);
+        dispatcher.stream(url,parserSink(parser),refreshPriority);
+    }
+}
+
+
+void DisneyWindow::requestData(WebDispatcher& dispatcher,const std::unordered_set<std::string>& failed,const std::unordered_set<std::string>& decoding,std::unordered_map<std::string,std::string>& setUrls,std::unordered_map<std::string,std::shared_ptr<CatalogParser>>& setParsers,std::unordered_map<std::string,std::pair<UrlId,int>>& imageUrls,std::vector<std::string>& encodedUrls)
+{
+    // request every set and tile image we want but don't have yet.  normally
+    // that's everything.  when loading lazily it's only what's on screen or
+    // within the prefetch distance of it.  the priority comes from how far
+    // off screen it is, so the visible tiles go first.  the dispatcher folds
+    // repeated requests for the same URL together, so a refId that shows up
+    // more than once is only fetched once.  when sizing or scaling images, a
+    // tile whose image is smaller than the current width is asked for again
+    // at that width.  images that are being decoded aren't asked for again.
+    // images we hold encoded aren't fetched, but are added to encodedUrls to
+    // be decoded once they're within the prefetch distance.  the caller must
+    // hold the lock
+    
+    m_encodedResidency.nextFrame();
+    
+    int firstRow = 0;
+    int lastRow = (int) m_tileSets.size() - 1;
+    
+    if(m_lazyLoading)
+    {
+        firstRow = std::max(firstRow,m_rowOffset - m_prefetchDistance);
+        lastRow = std::min(lastRow,m_rowOffset + 3 + m_prefetchDistance);
+    }
+    
+    for(int row = firstRow;row <= lastRow;++row)
+    {
+        const TileSet& tileSet = m_tileSets[row];
+        
+        int rowDistance = std::max(0,std::max(m_rowOffset - row,row - (m_rowOffset + 3)));
+        
+        if(!tileSet.loaded)
+        {
+            std::string url = setUrl(tileSet.refId);
+            
+            setUrls[url] = tileSet.refId;
+            
+            
+            // sets go to their parser as they download.  the parser outlives
+            // the request, and starts over if the transfer is restarted
+            std::shared_ptr<CatalogParser>& parser = setParsers[url];
+            
+            if(!parser)
+                parser = CatalogParser::create(m_parserBackend,CatalogParser::SetDocument);
+            
+            dispatcher.stream(url,parserSink(parser),priority(rowDistance));
+            
+            continue;
+        }
+        
+        
+        // 5 whole tiles and a half tile are on screen
+        int firstColumn = 0;
+        int lastColumn = (int) tileSet.tiles.size() - 1;
+        
+        if(m_lazyLoading)
+        {
+            firstColumn = std::max(firstColumn,tileSet.columnOffset - m_prefetchDistance);
+            lastColumn = std::min(lastColumn,tileSet.columnOffset + 5 + m_prefetchDistance);
+        }
+        
+        for(int column = firstColumn;column <= lastColumn;++column)
+        {
+            UrlId url = m_tiles.url(tileSet.tiles[column]);
+            
+            auto widthIndex = m_imageWidths.find(url);
+            
+            if(widthIndex != m_imageWidths.end()  &&  widthIndex->second >= m_imageWidth)
+                continue;
+            
+            std::string requestUrl = m_tiles.urlText(url);
+            
+            if(m_sizedImages)
+                requestUrl = queryUrl(requestUrl,"width",std::to_string(m_imageWidth));
+            
+            if(m_webpImages)
+                requestUrl = queryUrl(requestUrl,"format","webp");
+            
+            if(failed.find(requestUrl) != failed.end()  ||  decoding.find(requestUrl) != decoding.end())
+                continue;
+            
+            int columnDistance = std::max(0,std::max(tileSet.columnOffset - column,column - (tileSet.columnOffset + 5)));
+            int distance = std::max(rowDistance,columnDistance);
+            
+            auto encodedIndex = m_encodedImages.find(url);
+            
+            if(encodedIndex != m_encodedImages.end()  &&  encodedIndex->second.second >= m_imageWidth)
+            {
+                if(distance <= m_prefetchDistance  &&  imageUrls.find(requestUrl) == imageUrls.end())
+                {
+                    m_encodedResidency.use(url,encodedIndex->second.first.size());
+                    
+                    imageUrls[requestUrl] = std::make_pair(url,encodedIndex->second.second);
+                    encodedUrls.push_back(requestUrl);
                 }
+                
+                continue;
             }
+            
+            imageUrls[requestUrl] = std::make_pair(url,m_imageWidth);
+            dispatcher.request(requestUrl,priority(distance));
         }
     }
+}
+
+
+void DisneyWindow::storeImage(UrlId url,int width,std::shared_ptr<Image>& image)
+{
+    // keep a decoded image for the grid.  a smaller image that was still in
+    // flight when the width went up doesn't replace a bigger one.  the caller
+    // must hold the lock
+    
+    auto widthIndex = m_imageWidths.find(url);
+    
+    if(widthIndex == m_imageWidths.end()  ||  widthIndex->second < width)
+    {
+        m_imageResidency.use(url,image->size());
+        
+        m_images[url] = std::move(image);
+        m_imageWidths[url] = width;
+    }
+}
+
+
+void DisneyWindow::storeEncoded(UrlId url,int width,const std::string& data)
+{
+    // keep a downloaded image as it came, copied so the download buffer can
+    // go back to the dispatcher.  what was kept least recently goes once
+    // we're over budget.  the caller must hold the lock
+    
+    auto encodedIndex = m_encodedImages.find(url);
+    
+    if(encodedIndex != m_encodedImages.end()  &&  encodedIndex->second.second > width)
+        return;
+    
+    m_encodedResidency.nextFrame();
+    m_encodedResidency.use(url,data.size());
+    
+    m_encodedImages[url] = std::make_pair(data,width);
+    
+    uint32_t key;
+    
+    while(m_encodedResidency.evict(key))
+        m_encodedImages.erase(key);
+}
+
+
+bool DisneyWindow::nearViewport(UrlId url) const
+{
+    // whether a tile with this art is on screen or within the prefetch
+    // distance of it.  the caller must hold the lock
+    
+    int firstRow = std::max(0,m_rowOffset - m_prefetchDistance);
+    int lastRow = std::min((int) m_tileSets.size() - 1,m_rowOffset + 3 + m_prefetchDistance);
+    
+    for(int row = firstRow;row <= lastRow;++row)
+    {
+        const TileSet& tileSet = m_tileSets[row];
+        
+        int firstColumn = std::max(0,tileSet.columnOffset - m_prefetchDistance);
+        int lastColumn = std::min((int) tileSet.tiles.size() - 1,tileSet.columnOffset + 5 + m_prefetchDistance);
+        
+        for(int column = firstColumn;column <= lastColumn;++column)
+        {
+            if(m_tiles.url(tileSet.tiles[column]) == url)
+                return true;
+        }
+    }
+    
+    return false;
+}
+
+
+WebDispatcher::Priority DisneyWindow::priority(int distance) const
+{
+    // how urgent something is, given how many rows or columns it is from
+    // being on screen
+    
+    if(distance <= 0)
+        return WebDispatcher::PriorityVisible;
+    
+    if(distance == 1)
+        return WebDispatcher::PriorityAdjacent;
+    
+    if(distance <= m_prefetchDistance)
+        return WebDispatcher::PriorityPrefetch;
+    
+    return WebDispatcher::PriorityBackground;
+}
+
+
+void DisneyWindow::updateImageWidth(int framebufferWidth)
+{
+    // the widest a tile is ever drawn is the selected tile, at 95% of a grid
+    // column, with 5.5 columns across the window.  if that lands on a bigger
+    // step than before, the worker has sharper images to go and get, or
+    // decode again bigger.  it never steps down, since the images we have
+    // already look fine smaller.  the caller must hold the lock
+    
+    if(!m_sizedImages  &&  !m_scaledDecoding)
+        return;
+    
+    
+    int pixels = (int) std::ceil(framebufferWidth / 5.5f * 0.95f);
+    int imageWidth = imageWidthStep(pixels);
+    
+    if(imageWidth > m_imageWidth)
+    {
+        m_imageWidth = imageWidth;
+        
+        m_viewportChanged = true;
+        m_workerCondition.notify_all();
+    }
+}
+
+
+void DisneyWindow::updateBootstrapState()
+{
+    // the grid goes up once the rows on screen are loaded, or once there's
+    // nothing left to wait for.  the caller must hold the lock
+    
+    if(m_bootstrapState != BootstrapRows)
+        return;
+    
+    
+    for(int row = m_rowOffset;row < m_rowOffset + 4  &&  row < (int) m_tileSets.size();++row)
+    {
+        if(!m_tileSets[row].loaded)
+            return;
+    }
     
-    std::cout << "worker thread finished" << std::endl;
+    m_bootstrapState = m_tileSets.empty() ? BootstrapFailed : BootstrapReady;
 }
@@ -1,16 +1,26 @@
 #pragma once
+#include <condition_variable>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include "CancellationToken.h"
+#include "Catalog.h"
+#include "CatalogParser.h"
+#include "DecodePool.h"
 #include "Font.h"
 #include "Image.h"
-#include "nlohmann/json.hpp"
 #include "Rectangle.h"
+#include "Residency.h"
 #include "Texture.h"
+#include "TextureCache.h"
+#include "TileTable.h"
 #include "VideoDecoder.h"
+#include "WebCache.h"
+#include "WebDispatcher.h"
 #include "WebSupplicant.h"
 #include "Window.h"
 
@@ -18,27 +28,31 @@
 class DisneyWindow : public Window
 {
     private:
-        struct Tile
+        enum BootstrapState
         {
-            std::string name;
-            std::string releaseDate;
-            std::string rating;
-            std::string url;
-            std::string videoUrl;
-            std::shared_ptr<Texture> texture;
-        };
-        
-        struct TileSet
-        {
-            std::string name;
-            std::vector<Tile> tiles;
-            int columnOffset;
+            BootstrapCatalog,
+            BootstrapRows,
+            BootstrapReady,
+            BootstrapFailed
         };
         
     public:
         DisneyWindow(std::string binaryPath);
         ~DisneyWindow();
         
+        void setLazyLoading(bool lazyLoading,int prefetchDistance = 1);
+        void setSizedImages(bool sizedImages);
+        void setScaledDecoding(bool scaledDecoding);
+        void setWebpImages(bool webpImages);
+        void setParserBackend(CatalogParser::Backend backend);
+        void setSnapshots(bool snapshots);
+        void setTextureCaching(bool textureCaching);
+        void setCompressedTextures(bool compressedTextures);
+        void setRefreshInterval(double seconds);
+        void setImageBudget(size_t bytes);
+        void setTextureBudget(size_t bytes);
+        void setEncodedBudget(size_t bytes);
+        
     protected:
         bool onCreate();
         void onDestroy();
@@ -49,10 +63,20 @@ class DisneyWindow : public Window
         void onRender();
     
     private:
-        void parseStandardCollection(nlohmann::json& standardCollection,std::vector<TileSet>& tileSets);
-        void parseSet(nlohmann::json& set,std::vector<TileSet>& tileSets);
+        bool tile(int row,int column,TileId& id) const;
+        
+        void resolveSetRef(const std::string& refId,const TileSet *tileSet,const TileTable& tiles);
+        void applyCatalog(std::vector<TileSet>& tileSets,TileTable& tiles,std::unordered_map<std::string,std::pair<UrlId,int>>& imageUrls);
+        void requestRefresh(WebDispatcher& dispatcher,const std::vector<TileSet>& tileSets,std::unordered_map<std::string,std::string>& setUrls,std::unordered_map<std::string,std::shared_ptr<CatalogParser>>& setParsers,std::unordered_set<std::string>& refreshUrls,WebDispatcher::Priority refreshPriority);
+        void requestData(WebDispatcher& dispatcher,const std::unordered_set<std::string>& failed,const std::unordered_set<std::string>& decoding,std::unordered_map<std::string,std::string>& setUrls,std::unordered_map<std::string,std::shared_ptr<CatalogParser>>& setParsers,std::unordered_map<std::string,std::pair<UrlId,int>>& imageUrls,std::vector<std::string>& encodedUrls);
+        void storeImage(UrlId url,int width,std::shared_ptr<Image>& image);
+        void storeEncoded(UrlId url,int width,const std::string& data);
+        bool nearViewport(UrlId url) const;
+        WebDispatcher::Priority priority(int distance) const;
+        void updateImageWidth(int framebufferWidth);
+        void updateBootstrapState();
         
-        static void loadTextures(DisneyWindow *object);
+        static void loadCatalog(DisneyWindow *object);
     
     private:
         std::string m_binaryPath;
@@ -60,13 +84,43 @@ class DisneyWindow : public Window
         
         Font m_font;
         
+        WebCache m_cache;
+        TextureCache m_textureCache;
         WebSupplicant m_supplicant;
         std::vector<TileSet> m_tileSets;
+        TileTable m_tiles;
         
         std::mutex m_mutex;
-        std::unordered_map<std::string,std::shared_ptr<Image>> m_images;
+        std::unordered_map<UrlId,std::shared_ptr<Image>> m_images;
+        std::unordered_map<UrlId,int> m_imageWidths;
+        std::vector<std::shared_ptr<Texture>> m_retiredTextures;
+        Residency m_imageResidency;
+        Residency m_textureResidency;
+        std::unordered_map<UrlId,std::pair<std::string,int>> m_encodedImages;
+        Residency m_encodedResidency;
+        unsigned m_urlGeneration;
 
         std::thread m_worker;
+        BootstrapState m_bootstrapState;
+        bool m_gridShown;
+        
+        bool m_lazyLoading;
+        int m_prefetchDistance;
+        bool m_sizedImages;
+        bool m_scaledDecoding;
+        bool m_webpImages;
+        CatalogParser::Backend m_parserBackend;
+        bool m_snapshots;
+        bool m_textureCaching;
+        bool m_compressedTextures;
+        Image::Compression m_textureCompression;
+        bool m_warmStart;
+        double m_refreshInterval;
+        int m_imageWidth;
+        bool m_viewportChanged;
+        bool m_stopping;
+        CancellationToken m_cancellation;
+        std::condition_variable m_workerCondition;
         
         double m_startTime;
         double m_currentTime;
@@ -0,0 +1,242 @@
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "Arena.h"
+#include "DomCatalogParser.h"
+#include "nlohmann/json.hpp"
+
+
+// this backend collects the whole document and parses it into a DOM before
+// walking it.  lookups go through const references and find(), since
+// operator[] on a non-const object inserts nulls for missing keys, and auto
+// copies whole subtrees.
+//
+// the DOM is made of tens of thousands of small nodes and strings that only
+// live until the walk is done, so they're all taken from an arena that the
+// parser rewinds for each document, rather than from the heap one at a time
+
+
+typedef std::basic_string<char,std::char_traits<char>,ArenaAllocator<char>> ArenaString;
+typedef nlohmann::basic_json<std::map,std::vector,ArenaString,bool,std::int64_t,std::uint64_t,double,ArenaAllocator> Json;
+
+
+static const Json::json_pointer containersPointer("/data/StandardCollection/containers");
+static const Json::json_pointer setNamePointer("/text/title/full/set/default/content");
+static const Json::json_pointer tileNamesPointer("/text/title/full");
+static const Json::json_pointer tileUrlsPointer("/image/tile/1.78");
+static const Json::json_pointer contentPointer("/default/content");
+static const Json::json_pointer urlPointer("/default/url");
+static const Json::json_pointer ratingPointer("/ratings/0/value");
+static const Json::json_pointer releaseDatePointer("/releases/0/releaseDate");
+static const Json::json_pointer videoUrlPointer("/videoArt/0/mediaMetadata/urls/0/url");
+
+
+static const Json& lookup(const Json& value,const Json::json_pointer& pointer)
+{
+    static const Json null;
+    
+    return value.contains(pointer) ? value.at(pointer) : null;
+}
+
+
+static const Json& first(const Json& value)
+{
+    // the first element of an array, or the member of an object with the
+    // smallest key, since nlohmann keeps objects sorted
+    
+    static const Json null;
+    
+    if((!value.is_array()  &&  !value.is_object())  ||  value.empty())
+        return null;
+    
+    return value.front();
+}
+
+
+static std::string text(const Json& value)
+{
+    const ArenaString *text = value.get_ptr<const ArenaString *>();
+    
+    return text ? std::string(text->data(),text->size()) : std::string();
+}
+
+
+static void parseSet(const Json& set,TileTable& tiles,std::vector<TileSet>& tileSets)
+{
+    // a SetRef has no items of its own.  it's left as an empty row for the
+    // worker to fill in from its own document
+    
+    if(!set.is_object())
+        return;
+    
+    
+    TileSet tileSet;
+    tileSet.name = text(lookup(set,setNamePointer));
+    tileSet.columnOffset = 0;
+    tileSet.loaded = true;
+    
+    auto type = set.find("type");
+    
+    if(type != set.end()  &&  *type == "SetRef")
+    {
+        auto refId = set.find("refId");
+        
+        tileSet.refId = refId != set.end() ? text(*refId) : std::string();
+        tileSet.loaded = false;
+        
+        tileSets.push_back(std::move(tileSet));
+        return;
+    }
+    
+    
+    auto items = set.find("items");
+    
+    if(items != set.end()  &&  items->is_array())
+    {
+        tileSet.tiles.reserve(items->size());
+        
+        Tile tile;
+        
+        for(const Json& item : *items)
+        {
+            if(!item.is_object())
+                continue;
+            
+            tile.name = text(lookup(first(lookup(item,tileNamesPointer)),contentPointer));
+            tile.url = text(lookup(first(lookup(item,tileUrlsPointer)),urlPointer));
+            tile.rating = text(lookup(item,ratingPointer));
+            tile.releaseDate = text(lookup(item,releaseDatePointer));
+            tile.videoUrl = text(lookup(item,videoUrlPointer));
+            
+            tileSet.tiles.push_back(tiles.add(tile));
+        }
+    }
+    
+    tileSets.push_back(std::move(tileSet));
+}
+
+
+struct DomCatalogParser::PrivateImpl
+{
+    Document document;
+    std::string buffer;
+    Arena arena;
+    std::vector<TileSet> tileSets;
+    TileTable tiles;
+};
+
+
+DomCatalogParser::DomCatalogParser(Document document) :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+        m_impl->document = document;
+}
+
+
+DomCatalogParser::~DomCatalogParser()
+{
+    if(m_impl)
+        delete m_impl;
+}
+
+
+void DomCatalogParser::reset()
+{
+    if(!m_impl)
+        return;
+    
+    m_impl->buffer.clear();
+    m_impl->tileSets.clear();
+    m_impl->tiles.clear();
+}
+
+
+bool DomCatalogParser::feed(const char *data,size_t size)
+{
+    if(!m_impl)
+        return false;
+    
+    m_impl->buffer.append(data,size);
+    
+    return true;
+}
+
+
+bool DomCatalogParser::finish()
+{
+    if(!m_impl)
+        return false;
+    
+    
+    // the document has to be gone before the arena goes out of scope, and
+    // the arena is only rewound after that
+    bool ok = parse();
+    
+    m_impl->arena.reset();
+    
+    return ok;
+}
+
+
+bool DomCatalogParser::parse()
+{
+    // the DOM takes a few times the size of the text, so one block that size
+    // usually holds all of it
+    m_impl->arena.reserve(m_impl->buffer.size() * 3);
+    
+    Arena::Scope scope(m_impl->arena);
+    Json document = Json::parse(m_impl->buffer,nullptr,false);
+    
+    std::string().swap(m_impl->buffer);
+    
+    if(document.is_discarded())
+    {
+        std::cerr << "DomCatalogParser::finish:  error parsing document" << std::endl;
+        return false;
+    }
+    
+    
+    if(m_impl->document == HomeDocument)
+    {
+        const Json& containers = lookup(document,containersPointer);
+        
+        if(containers.is_array())
+        {
+            for(const Json& container : containers)
+            {
+                if(container.is_object()  &&  container.contains("set"))
+                    parseSet(container["set"],m_impl->tiles,m_impl->tileSets);
+            }
+        }
+    }
+    else
+    {
+        auto data = document.find("data");
+        
+        if(data != document.end()  &&  data->is_object())
+        {
+            for(const Json& set : *data)
+                parseSet(set,m_impl->tiles,m_impl->tileSets);
+        }
+    }
+    
+    return true;
+}
+
+
+std::vector<TileSet> DomCatalogParser::takeTileSets(TileTable& tiles)
+{
+    if(!m_impl)
+        return std::vector<TileSet>();
+    
+    std::vector<TileSet> tileSets;
+    tileSets.swap(m_impl->tileSets);
+    
+    tiles.swap(m_impl->tiles);
+    m_impl->tiles.clear();
+    
+    return tileSets;
+}
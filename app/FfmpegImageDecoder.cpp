@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+}
+#include "FfmpegImageDecoder.h"
+#include "Image.h"
+
+
+// ffmpeg is already there for the videos, and has decoders for all three
+// formats the CDN serves.  its JPEG decoder can skip the high frequencies of
+// each block and come out at 1/2, 1/4 or 1/8 of the size, for a fraction of
+// the work.  swscale then turns the frame to RGB at the width we want, bottom
+// row first, in a single pass
+
+
+static bool jpegSize(const unsigned char *data,int length,int& width,int& height)
+{
+    // find the size of a JPEG without decoding it, by walking its markers up
+    // to the start of the frame.  this returns false for anything that isn't
+    // a JPEG
+    
+    if(length < 4  ||  data[0] != 0xff  ||  data[1] != 0xd8)
+        return false;
+    
+    int offset = 2;
+    
+    while(offset + 4 <= length)
+    {
+        if(data[offset] != 0xff)
+            return false;
+        
+        unsigned char marker = data[offset + 1];
+        
+        // fill bytes, and markers without a length
+        if(marker == 0xff)
+        {
+            ++offset;
+            continue;
+        }
+        
+        if(marker == 0x01  ||  (marker >= 0xd0  &&  marker <= 0xd8))
+        {
+            offset += 2;
+            continue;
+        }
+        
+        
+        // every start of frame marker but DHT, JPG and DAC has the size in it
+        if(marker >= 0xc0  &&  marker <= 0xcf  &&  marker != 0xc4  &&  marker != 0xc8  &&  marker != 0xcc)
+        {
+            if(offset + 9 > length)
+                return false;
+            
+            height = (data[offset + 5] << 8) | data[offset + 6];
+            width = (data[offset + 7] << 8) | data[offset + 8];
+            
+            return width > 0  &&  height > 0;
+        }
+        
+        offset += 2 + ((data[offset + 2] << 8) | data[offset + 3]);
+    }
+    
+    return false;
+}
+
+
+static AVFrame *decodeFrame(AVCodecID codecId,const unsigned char *data,int length,int lowres)
+{
+    // decode a single picture.  this returns the frame in whatever pixel
+    // format the file uses, or nullptr if it couldn't be decoded
+    
+    const AVCodec *codec = ::avcodec_find_decoder(codecId);
+    
+    if(!codec)
+        return nullptr;
+    
+    AVCodecContext *context = ::avcodec_alloc_context3(codec);
+    AVPacket *packet = ::av_packet_alloc();
+    AVFrame *frame = ::av_frame_alloc();
+    
+    bool decoded = false;
+    
+    if(context  &&  packet  &&  frame)
+    {
+        // we're already on one of several decoding threads
+        context->lowres = std::min(lowres,(int) codec->max_lowres);
+        context->thread_count = 1;
+        
+        packet->data = (uint8_t *) data;
+        packet->size = length;
+        
+        decoded = ::avcodec_open2(context,codec,nullptr) >= 0  &&
+                  ::avcodec_send_packet(context,packet) >= 0  &&
+                  ::avcodec_send_packet(context,nullptr) >= 0  &&
+                  ::avcodec_receive_frame(context,frame) >= 0;
+    }
+    
+    ::av_packet_free(&packet);
+    ::avcodec_free_context(&context);
+    
+    if(!decoded)
+        ::av_frame_free(&frame);
+    
+    return frame;
+}
+
+
+bool FfmpegImageDecoder::decode(const unsigned char *data,int length,int width,Image& image) const
+{
+    AVCodecID codecId;
+    
+    switch(ImageDecoder::format(data,length))
+    {
+        case FormatJpeg:
+            codecId = AV_CODEC_ID_MJPEG;
+            break;
+        
+        case FormatPng:
+            codecId = AV_CODEC_ID_PNG;
+            break;
+        
+        case FormatWebp:
+            codecId = AV_CODEC_ID_WEBP;
+            break;
+        
+        default:
+            return false;
+    }
+    
+    
+    // decode a JPEG straight to the nearest power of two at or above the width
+    int lowres = 0;
+    int fileWidth,fileHeight;
+    
+    if(codecId == AV_CODEC_ID_MJPEG  &&  width > 0  &&  jpegSize(data,length,fileWidth,fileHeight))
+    {
+        while(lowres < 3  &&  (fileWidth >> (lowres + 1)) >= width)
+            ++lowres;
+    }
+    
+    AVFrame *frame = decodeFrame(codecId,data,length,lowres);
+    
+    if(!frame)
+    {
+        std::cerr << "FfmpegImageDecoder::decode:  error decoding image" << std::endl;
+        return false;
+    }
+    
+    
+    // keep the alpha channel only if there is one
+    const AVPixFmtDescriptor *descriptor = ::av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+    bool alpha = descriptor  &&  (descriptor->flags & AV_PIX_FMT_FLAG_ALPHA);
+    
+    AVPixelFormat format = alpha ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGB24;
+    int bitsPerPixel = alpha ? 32 : 24;
+    
+    int imageWidth = frame->width;
+    int imageHeight = frame->height;
+    
+    if(width > 0  &&  imageWidth > width)
+    {
+        imageHeight = std::max(1,(int) std::lround((double) imageHeight * width / imageWidth));
+        imageWidth = width;
+    }
+    
+    SwsContext *scaleContext = ::sws_getContext(frame->width,frame->height,(AVPixelFormat) frame->format,
+                                                imageWidth,imageHeight,format,
+                                                SWS_AREA,nullptr,nullptr,nullptr);
+    
+    bool scaled = false;
+    
+    if(scaleContext  &&  image.create(imageWidth,imageHeight,bitsPerPixel))
+    {
+        // write from the last row up, which flips it the way textures want
+        int stride = imageWidth * bitsPerPixel / 8;
+        
+        uint8_t *destination[4] = { (uint8_t *) image.pixelData() + (imageHeight - 1) * stride,nullptr,nullptr,nullptr };
+        int destinationLineSize[4] = { -stride,0,0,0 };
+        
+        scaled = ::sws_scale(scaleContext,(const uint8_t **) frame->data,frame->linesize,
+                             0,frame->height,destination,destinationLineSize) == imageHeight;
+    }
+    
+    ::sws_freeContext(scaleContext);
+    ::av_frame_free(&frame);
+    
+    if(!scaled)
+    {
+        std::cerr << "FfmpegImageDecoder::decode:  error converting image" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
@@ -5,42 +5,12 @@
 #include <map>
 #include "Font.h"
 #include "glad/glad.h"
+#include "GraphicsCache.h"
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
 #include "Texture.h"
 
 
-static const char *vertexShaderSource =
-"#version 330 core\n"
-"layout (location = 0) in vec3 aPos;\n"
-"layout (location = 1) in vec2 aTexCoord;\n"
-"\n"
-"out vec2 texCoord;\n"
-"\n"
-"void main()\n"
-"{\n"
-"    gl_Position = vec4(aPos,1.0);\n"
-"    texCoord = aTexCoord;\n"
-"}\n\0";
-
-
-// this shader returns white pixels with the alpha channel derived from the
-// single-channel font bitmap that we build below
-
-static const char *fragmentShaderSource =
-"#version 330 core\n"
-"in vec2 texCoord;\n"
-"\n"
-"out vec4 FragColor;\n"
-"\n"
-"uniform sampler2D ourTexture;\n"
-"\n"
-"void main()\n"
-"{\n"
-"    FragColor = vec4(1.0,1.0,1.0,texture(ourTexture,texCoord));\n"
-"}\n\0";
-
-
 struct Extent
 {
     int x;
@@ -59,10 +29,6 @@ struct Font::PrivateImpl
     
     std::map<int,Extent> extents;
     
-    unsigned int shaderProgram;
-    unsigned int vao;
-    unsigned int vbo;
-    unsigned int ebo;
     unsigned int texture;
 };
 
@@ -75,10 +41,6 @@ Font::Font() :
         m_impl->bitmapWidth = 0;
         m_impl->bitmapHeight = 0;
         
-        m_impl->shaderProgram = 0;
-        m_impl->vao = 0;
-        m_impl->vbo = 0;
-        m_impl->ebo = 0;
         m_impl->texture = 0;
     }
 }
@@ -99,7 +61,7 @@ bool Font::valid() const
     if(!m_impl)
         return false;
     
-    return m_impl->shaderProgram  &&  m_impl->vao  &&  m_impl->vbo  &&  m_impl->ebo  &&  m_impl->texture;
+    return m_impl->texture != 0;
 }
 
 
@@ -204,92 +166,7 @@ bool Font::load(const std::string& filename,float lineHeight)
             image.load(bitmap,m_impl->bitmapWidth,m_impl->bitmapHeight,8);
             
             
-            // create and compile vertex shader
-
-            unsigned int vertexShader = ::glCreateShader(GL_VERTEX_SHADER);
-            ::glShaderSource(vertexShader,1,&vertexShaderSource,nullptr);
-            ::glCompileShader(vertexShader);
-
-            int success;
-            ::glGetShaderiv(vertexShader,GL_COMPILE_STATUS,&success);
-
-            if(!success)
-            {
-                char infoLog[512];
-                ::glGetShaderInfoLog(vertexShader,512,nullptr,infoLog);
-                std::cout << "Texture::create:  error compiling vertex shader:  " << infoLog << std::endl;
-                return false;
-            }
-
-
-            // create and compile fragment shader
-
-            unsigned int fragmentShader = ::glCreateShader(GL_FRAGMENT_SHADER);
-            ::glShaderSource(fragmentShader,1,&fragmentShaderSource,nullptr);
-            ::glCompileShader(fragmentShader);
-
-            ::glGetShaderiv(fragmentShader,GL_COMPILE_STATUS,&success);
-
-            if(!success)
-            {
-                char infoLog[512];
-                ::glGetShaderInfoLog(fragmentShader,512,nullptr,infoLog);
-                std::cout << "Texture::create:  error compiling fragment shader:  " << infoLog << std::endl;
-                return false;
-            }
-
-
-            // create and link shader program
-
-            m_impl->shaderProgram = ::glCreateProgram();
-            ::glAttachShader(m_impl->shaderProgram,vertexShader);
-            ::glAttachShader(m_impl->shaderProgram,fragmentShader);
-            ::glLinkProgram(m_impl->shaderProgram);
-
-            ::glGetProgramiv(m_impl->shaderProgram,GL_LINK_STATUS,&success);
-
-            if(!success)
-            {
-                char infoLog[512];
-                ::glGetProgramInfoLog(m_impl->shaderProgram,512,nullptr,infoLog);
-                std::cout << "Texture::create:  error linking shader program:  " << infoLog << std::endl;
-                return false;
-            }
-
-
-            ::glDeleteShader(vertexShader);
-            ::glDeleteShader(fragmentShader);
-
-
-
-
-            float vertices[] =
-            {
-                // positions         // texture coords
-                 1.0f,  1.0f, 0.0f,  1.0f, 1.0f,
-                 1.0f, -1.0f, 0.0f,  1.0f, 0.0f,
-                -1.0f, -1.0f, 0.0f,  0.0f, 0.0f,
-                -1.0f,  1.0f, 0.0f,  0.0f, 1.0f
-            };
-
-            unsigned int indices[] =
-            {
-                0, 1, 3,
-                1, 2, 3
-            };
-
-
-            ::glGenVertexArrays(1,&m_impl->vao);
-            ::glBindVertexArray(m_impl->vao);
-
-            ::glGenBuffers(1,&m_impl->vbo);
-            ::glBindBuffer(GL_ARRAY_BUFFER,m_impl->vbo);
-            ::glBufferData(GL_ARRAY_BUFFER,sizeof(vertices),vertices,GL_STATIC_DRAW);
-
-            ::glGenBuffers(1,&m_impl->ebo);
-            ::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,m_impl->ebo);
-            ::glBufferData(GL_ELEMENT_ARRAY_BUFFER,sizeof(indices),indices,GL_STATIC_DRAW);
-
+            // the shaders and the quad are shared, so this is just the bitmap
             ::glGenTextures(1,&m_impl->texture);
             ::glBindTexture(GL_TEXTURE_2D,m_impl->texture);
             ::glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_REPEAT);
@@ -305,14 +182,6 @@ bool Font::load(const std::string& filename,float lineHeight)
 
             ::glEnable(GL_BLEND);
             ::glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-
-            // position attribute
-            ::glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,5 * sizeof(float),(void *) 0);
-            ::glEnableVertexAttribArray(0);
-
-            // texture coord attribute
-            ::glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,5 * sizeof(float),(void *)(3 * sizeof(float)));
-            ::glEnableVertexAttribArray(1);
             
             
             delete[] bitmap;
@@ -346,35 +215,11 @@ void Font::destroy()
     m_impl->bitmapWidth = 0;
     m_impl->bitmapHeight = 0;
     
-    if(m_impl->vao)
-    {
-        ::glDeleteVertexArrays(1,&m_impl->vao);
-        m_impl->vao = 0;
-    }
-    
-    if(m_impl->vbo)
-    {
-        ::glDeleteBuffers(1,&m_impl->vbo);
-        m_impl->vbo = 0;
-    }
-    
-    if(m_impl->ebo)
-    {
-        ::glDeleteBuffers(1,&m_impl->ebo);
-        m_impl->ebo = 0;
-    }
-    
     if(m_impl->texture)
     {
         ::glDeleteTextures(1,&m_impl->texture);
         m_impl->texture = 0;
     }
-
-    if(m_impl->shaderProgram)
-    {
-        ::glDeleteProgram(m_impl->shaderProgram);
-        m_impl->shaderProgram = 0;
-    }
 }
 
 
@@ -389,6 +234,12 @@ void Font::drawText(const std::string& text,
     if(!valid())
         return;
     
+    GraphicsCache *cache = GraphicsCache::current();
+    unsigned int program = cache ? cache->program(GraphicsCache::ProgramText) : 0;
+    
+    if(!program  ||  !cache->bind(GraphicsCache::GeometryQuad))
+        return;
+    
     
     GLint viewport[4];
     ::glGetIntegerv(GL_VIEWPORT,viewport);
@@ -401,11 +252,7 @@ void Font::drawText(const std::string& text,
     
     
     ::glBindTexture(GL_TEXTURE_2D,m_impl->texture);
-    
-    ::glUseProgram(m_impl->shaderProgram);
-    ::glBindVertexArray(m_impl->vao);
-
-    ::glBindBuffer(GL_ARRAY_BUFFER,m_impl->vbo);
+    ::glUseProgram(program);
     
     
     float x = screenX;
@@ -433,7 +280,7 @@ void Font::drawText(const std::string& text,
             x + xOff,         screenY + yOff + height, 0.0f,  textureX, textureY + textureHeight
         };
         
-        ::glBufferData(GL_ARRAY_BUFFER,sizeof(vertices),vertices,GL_STATIC_DRAW);
+        ::glBufferSubData(GL_ARRAY_BUFFER,0,sizeof(vertices),vertices);
 
         ::glDrawElements(GL_TRIANGLES,6,GL_UNSIGNED_INT,0);
 
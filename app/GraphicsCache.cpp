@@ -0,0 +1,361 @@
+#include <iostream>
+#include "glad/glad.h"
+#include "GraphicsCache.h"
+
+
+// everything we draw is a textured quad, a quad of text, or the outline of
+// one, so there are only three shader programs and two sets of geometry for
+// the whole window.  they're made the first time they're asked for, and kept
+// until the context goes.  the vertices are written over on each draw, so the
+// buffers are shared by every texture, font and rectangle
+//
+// GL objects belong to a context, so there's a cache for each window.  the
+// window makes its cache current along with its context
+
+
+static const char *quadVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout (location = 1) in vec2 aTexCoord;\n"
+"\n"
+"out vec2 texCoord;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    gl_Position = vec4(aPos,1.0);\n"
+"    texCoord = aTexCoord;\n"
+"}\n\0";
+
+static const char *textureFragmentShaderSource =
+"#version 330 core\n"
+"in vec2 texCoord;\n"
+"\n"
+"out vec4 FragColor;\n"
+"\n"
+"uniform sampler2D ourTexture;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    FragColor = texture(ourTexture,texCoord);\n"
+"}\n\0";
+
+
+// this shader returns white pixels with the alpha channel derived from the
+// single-channel font bitmap
+
+static const char *textFragmentShaderSource =
+"#version 330 core\n"
+"in vec2 texCoord;\n"
+"\n"
+"out vec4 FragColor;\n"
+"\n"
+"uniform sampler2D ourTexture;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    FragColor = vec4(1.0,1.0,1.0,texture(ourTexture,texCoord));\n"
+"}\n\0";
+
+static const char *outlineVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    gl_Position = vec4(aPos,1.0);\n"
+"}\n\0";
+
+static const char *outlineFragmentShaderSource =
+"#version 330 core\n"
+"out vec4 FragColor;\n"
+"\n"
+"void main()\n"
+"{\n"
+"    FragColor = vec4(1.0,1.0,1.0,1.0);\n"
+"}\n\0";
+
+
+static thread_local GraphicsCache *currentCache = nullptr;
+
+
+static unsigned int compileShader(GLenum type,const char *source)
+{
+    unsigned int shader = ::glCreateShader(type);
+    ::glShaderSource(shader,1,&source,nullptr);
+    ::glCompileShader(shader);
+    
+    int success;
+    ::glGetShaderiv(shader,GL_COMPILE_STATUS,&success);
+    
+    if(!success)
+    {
+        char infoLog[512];
+        ::glGetShaderInfoLog(shader,512,nullptr,infoLog);
+        std::cout << "GraphicsCache::program:  error compiling " << (type == GL_VERTEX_SHADER ? "vertex" : "fragment") << " shader:  " << infoLog << std::endl;
+        
+        ::glDeleteShader(shader);
+        return 0;
+    }
+    
+    return shader;
+}
+
+
+static unsigned int linkProgram(const char *vertexShaderSource,const char *fragmentShaderSource)
+{
+    unsigned int vertexShader = compileShader(GL_VERTEX_SHADER,vertexShaderSource);
+    unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER,fragmentShaderSource);
+    
+    unsigned int program = 0;
+    
+    if(vertexShader  &&  fragmentShader)
+    {
+        program = ::glCreateProgram();
+        ::glAttachShader(program,vertexShader);
+        ::glAttachShader(program,fragmentShader);
+        ::glLinkProgram(program);
+        
+        int success;
+        ::glGetProgramiv(program,GL_LINK_STATUS,&success);
+        
+        if(!success)
+        {
+            char infoLog[512];
+            ::glGetProgramInfoLog(program,512,nullptr,infoLog);
+            std::cout << "GraphicsCache::program:  error linking shader program:  " << infoLog << std::endl;
+            
+            ::glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    
+    if(vertexShader)
+        ::glDeleteShader(vertexShader);
+    
+    if(fragmentShader)
+        ::glDeleteShader(fragmentShader);
+    
+    return program;
+}
+
+
+struct GraphicsCache::PrivateImpl
+{
+    unsigned int programs[ProgramCount];
+    
+    unsigned int vaos[GeometryCount];
+    unsigned int vbos[GeometryCount];
+    unsigned int ebos[GeometryCount];
+};
+
+
+GraphicsCache::GraphicsCache() :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+    {
+        for(int index = 0;index < ProgramCount;++index)
+            m_impl->programs[index] = 0;
+        
+        for(int index = 0;index < GeometryCount;++index)
+        {
+            m_impl->vaos[index] = 0;
+            m_impl->vbos[index] = 0;
+            m_impl->ebos[index] = 0;
+        }
+    }
+}
+
+
+GraphicsCache::~GraphicsCache()
+{
+    // the context is usually gone by now, and its objects with it, so this
+    // doesn't call destroy()
+    
+    if(m_impl)
+    {
+        if(currentCache == this)
+            currentCache = nullptr;
+        
+        delete m_impl;
+    }
+}
+
+
+void GraphicsCache::makeCurrent()
+{
+    // make this the cache textures, fonts and rectangles draw with on this
+    // thread.  the window calls it whenever it makes its context current
+    
+    currentCache = this;
+}
+
+
+void GraphicsCache::destroy()
+{
+    // let go of everything, while the context is still current
+    
+    if(!m_impl)
+        return;
+    
+    
+    for(int index = 0;index < ProgramCount;++index)
+    {
+        if(m_impl->programs[index])
+        {
+            ::glDeleteProgram(m_impl->programs[index]);
+            m_impl->programs[index] = 0;
+        }
+    }
+    
+    for(int index = 0;index < GeometryCount;++index)
+    {
+        if(m_impl->vaos[index])
+        {
+            ::glDeleteVertexArrays(1,&m_impl->vaos[index]);
+            ::glDeleteBuffers(1,&m_impl->vbos[index]);
+            ::glDeleteBuffers(1,&m_impl->ebos[index]);
+            
+            m_impl->vaos[index] = 0;
+            m_impl->vbos[index] = 0;
+            m_impl->ebos[index] = 0;
+        }
+    }
+}
+
+
+unsigned int GraphicsCache::program(Program program)
+{
+    // the program, compiled and linked the first time it's asked for.  this
+    // returns 0 if it couldn't be
+    
+    if(!m_impl  ||  program < 0  ||  program >= ProgramCount)
+        return 0;
+    
+    if(m_impl->programs[program])
+        return m_impl->programs[program];
+    
+    
+    switch(program)
+    {
+        case ProgramTexture:
+            m_impl->programs[program] = linkProgram(quadVertexShaderSource,textureFragmentShaderSource);
+            break;
+        
+        case ProgramText:
+            m_impl->programs[program] = linkProgram(quadVertexShaderSource,textFragmentShaderSource);
+            break;
+        
+        case ProgramOutline:
+            m_impl->programs[program] = linkProgram(outlineVertexShaderSource,outlineFragmentShaderSource);
+            break;
+        
+        case ProgramCount:
+            break;
+    }
+    
+    return m_impl->programs[program];
+}
+
+
+bool GraphicsCache::bind(Geometry geometry)
+{
+    // bind the geometry's vertex array and vertex buffer, making them the
+    // first time.  the caller writes its vertices into the buffer before it
+    // draws:  for a quad, 4 corners of position and texture coordinates,
+    // drawn as 6 indices of triangles, and for an outline, 4 corners of
+    // position, drawn as 8 indices of lines
+    
+    if(!m_impl  ||  geometry < 0  ||  geometry >= GeometryCount)
+        return false;
+    
+    if(m_impl->vaos[geometry])
+    {
+        ::glBindVertexArray(m_impl->vaos[geometry]);
+        ::glBindBuffer(GL_ARRAY_BUFFER,m_impl->vbos[geometry]);
+        return true;
+    }
+    
+    
+    float quadVertices[] =
+    {
+        // positions         // texture coords
+         1.0f,  1.0f, 0.0f,  1.0f, 1.0f,
+         1.0f, -1.0f, 0.0f,  1.0f, 0.0f,
+        -1.0f, -1.0f, 0.0f,  0.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f,  0.0f, 1.0f
+    };
+    
+    unsigned int quadIndices[] =
+    {
+        0, 1, 3,
+        1, 2, 3
+    };
+    
+    float outlineVertices[] =
+    {
+        // positions
+         1.0f,  1.0f, 0.0f,
+         1.0f, -1.0f, 0.0f,
+        -1.0f, -1.0f, 0.0f,
+        -1.0f,  1.0f, 0.0f,
+    };
+    
+    unsigned int outlineIndices[] =
+    {
+        0, 1,
+        1, 2,
+        2, 3,
+        3, 0
+    };
+    
+    bool quad = geometry == GeometryQuad;
+    
+    
+    ::glGenVertexArrays(1,&m_impl->vaos[geometry]);
+    ::glBindVertexArray(m_impl->vaos[geometry]);
+    
+    ::glGenBuffers(1,&m_impl->vbos[geometry]);
+    ::glBindBuffer(GL_ARRAY_BUFFER,m_impl->vbos[geometry]);
+    
+    if(quad)
+        ::glBufferData(GL_ARRAY_BUFFER,sizeof(quadVertices),quadVertices,GL_DYNAMIC_DRAW);
+    else
+        ::glBufferData(GL_ARRAY_BUFFER,sizeof(outlineVertices),outlineVertices,GL_DYNAMIC_DRAW);
+    
+    ::glGenBuffers(1,&m_impl->ebos[geometry]);
+    ::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,m_impl->ebos[geometry]);
+    
+    if(quad)
+        ::glBufferData(GL_ELEMENT_ARRAY_BUFFER,sizeof(quadIndices),quadIndices,GL_STATIC_DRAW);
+    else
+        ::glBufferData(GL_ELEMENT_ARRAY_BUFFER,sizeof(outlineIndices),outlineIndices,GL_STATIC_DRAW);
+    
+    if(quad)
+    {
+        // position attribute
+        ::glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,5 * sizeof(float),(void *) 0);
+        ::glEnableVertexAttribArray(0);
+        
+        // texture coord attribute
+        ::glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,5 * sizeof(float),(void *)(3 * sizeof(float)));
+        ::glEnableVertexAttribArray(1);
+    }
+    else
+    {
+        // position attribute
+        ::glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,3 * sizeof(float),(void *) 0);
+        ::glEnableVertexAttribArray(0);
+    }
+    
+    return true;
+}
+
+
+GraphicsCache *GraphicsCache::current()
+{
+    // the cache for the context current on this thread, or nullptr if
+    // there's none
+    
+    return currentCache;
+}
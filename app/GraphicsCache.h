@@ -0,0 +1,37 @@
+#pragma once
+
+
+class GraphicsCache
+{
+    public:
+        enum Program
+        {
+            ProgramTexture,
+            ProgramText,
+            ProgramOutline,
+            ProgramCount
+        };
+        
+        enum Geometry
+        {
+            GeometryQuad,
+            GeometryOutline,
+            GeometryCount
+        };
+        
+    public:
+        GraphicsCache();
+        ~GraphicsCache();
+        
+        void makeCurrent();
+        void destroy();
+        
+        unsigned int program(Program program);
+        bool bind(Geometry geometry);
+        
+        static GraphicsCache *current();
+        
+    private:
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -1,18 +1,77 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
-#include <memory>
+#include <iterator>
+extern "C"
+{
+#include "libswscale/swscale.h"
+}
 #include "Image.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+
+// the backend picked for each format, plus one, so zero can mean whichever
+// is best of those built in.  decoding threads read these while the
+// window may be setting them
+static std::atomic<int> decoders[ImageDecoder::FormatCount];
+
+
+static ImageDecoder::Backend defaultDecoder(ImageDecoder::Format format)
+{
+    // the fastest backend we have for each format.  ffmpeg beats stb_image
+    // at JPEG by decoding straight to a smaller size, and is the only
+    // WebP decoder we have without libwebp
+    
+    switch(format)
+    {
+        case ImageDecoder::FormatJpeg:
+            return ImageDecoder::available(ImageDecoder::BackendTurboJpeg) ? ImageDecoder::BackendTurboJpeg : ImageDecoder::BackendFfmpeg;
+        
+        case ImageDecoder::FormatPng:
+            return ImageDecoder::available(ImageDecoder::BackendLibpng) ? ImageDecoder::BackendLibpng : ImageDecoder::BackendStb;
+        
+        case ImageDecoder::FormatWebp:
+            return ImageDecoder::available(ImageDecoder::BackendLibwebp) ? ImageDecoder::BackendLibwebp : ImageDecoder::BackendFfmpeg;
+        
+        default:
+            return ImageDecoder::BackendStb;
+    }
+}
+
+
+static AVPixelFormat pixelFormat(int bitsPerPixel)
+{
+    switch(bitsPerPixel)
+    {
+        case 8:
+            return AV_PIX_FMT_GRAY8;
+        
+        case 16:
+            return AV_PIX_FMT_YA8;
+        
+        case 24:
+            return AV_PIX_FMT_RGB24;
+        
+        case 32:
+            return AV_PIX_FMT_RGBA;
+        
+        default:
+            return AV_PIX_FMT_NONE;
+    }
+}
 
 
 struct Image::PrivateImpl
 {
     unsigned char *data;
-    bool useStdDelete;
+    std::function<void(void *)> release;
     int width;
     int height;
     int bitsPerPixel;
+    int levels;
+    Compression compression;
 };
 
 
@@ -22,10 +81,12 @@ Image::Image() :
     if(m_impl)
     {
         m_impl->data = nullptr;
-        m_impl->useStdDelete = true;
+        m_impl->release = nullptr;
         m_impl->width = 0;
         m_impl->height = 0;
         m_impl->bitsPerPixel = 0;
+        m_impl->levels = 0;
+        m_impl->compression = CompressionNone;
     }
 }
 
@@ -59,24 +120,17 @@ bool Image::load(const std::string& filename)
     destroy();
     
     
-    ::stbi_set_flip_vertically_on_load(true);
-    
-    
-    int width,height,bytes;
-    m_impl->data = ::stbi_load(filename.c_str(),&width,&height,&bytes,0);
+    std::ifstream file(filename,std::ios::binary);
     
-    if(!m_impl->data)
+    if(!file)
     {
-        std::cerr << "Image::load:  error loading file:  " << stbi_failure_reason() << std::endl;
+        std::cerr << "Image::load:  error opening file:  " << filename << std::endl;
         return false;
     }
     
-    m_impl->useStdDelete = false;
-    m_impl->width = width;
-    m_impl->height = height;
-    m_impl->bitsPerPixel = 8 * bytes;
+    std::string data((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
     
-    return true;
+    return load((const unsigned char *) data.data(),(int) data.size());
 }
 
 
@@ -85,28 +139,48 @@ bool Image::load(const unsigned char *data,int length)
     // this function loads an image file format from memory.  we probably got it
     // from the Disney server
     
+    return loadScaled(data,length,0);
+}
+
+
+bool Image::loadScaled(const unsigned char *data,int length,int width)
+{
+    // this function loads an image file format from memory, scaled down to
+    // the given width if it's any wider, since a tile is drawn much smaller
+    // than its art.  the format is told from the data and handed to the
+    // backend picked for it, which may decode straight to a smaller size.
+    // whatever is left is taken off by swscale.  either way, a lot less is
+    // kept around and uploaded
+    
     if(!m_impl)
         return false;
     
     destroy();
     
     
-    ::stbi_set_flip_vertically_on_load(true);
+    ImageDecoder::Format format = ImageDecoder::format(data,length);
+    ImageDecoder::Backend backend = decoder(format);
     
+    const ImageDecoder *imageDecoder = ImageDecoder::get(backend);
+    bool loaded = imageDecoder  &&  imageDecoder->decode(data,length,width,*this);
     
-    int width,height,bytes;
-    m_impl->data = ::stbi_load_from_memory(data,length,&width,&height,&bytes,0);
+    // stb_image is the fallback for anything the other backends can't read
+    if(!loaded  &&  backend != ImageDecoder::BackendStb  &&  ImageDecoder::supports(ImageDecoder::BackendStb,format))
+    {
+        destroy();
+        loaded = ImageDecoder::get(ImageDecoder::BackendStb)->decode(data,length,width,*this);
+    }
     
-    if(!m_impl->data)
+    if(!loaded)
     {
-        std::cerr << "Image::load:  error loading file:  " << stbi_failure_reason() << std::endl;
+        std::cerr << "Image::loadScaled:  error decoding " << ImageDecoder::name(format) << " image" << std::endl;
+        
+        destroy();
         return false;
     }
     
-    m_impl->useStdDelete = false;
-    m_impl->width = width;
-    m_impl->height = height;
-    m_impl->bitsPerPixel = 8 * bytes;
+    if(width > 0  &&  m_impl->width > width)
+        resize(width,std::max(1,(int) std::lround((double) m_impl->height * width / m_impl->width)));
     
     return true;
 }
@@ -120,10 +194,9 @@ bool Image::load(const unsigned char *data,int width,int height,int bitsPerPixel
     if(!m_impl)
         return false;
     
-    destroy();
-    
+    if(!create(width,height,bitsPerPixel))
+        return false;
     
-    m_impl->data = new unsigned char[width * height * (bitsPerPixel / 8)];
     int stride = width * (bitsPerPixel / 8);
     
     if(invert)
@@ -139,12 +212,163 @@ bool Image::load(const unsigned char *data,int width,int height,int bitsPerPixel
         memcpy(m_impl->data,data,height * stride);
     }
     
-    m_impl->useStdDelete = true;
+    return true;
+}
+
+
+bool Image::create(int width,int height,int bitsPerPixel)
+{
+    // make an uninitialised image for a decoder to write into, bottom row
+    // first
+    
+    if(!m_impl)
+        return false;
+    
+    if(width <= 0  ||  height <= 0  ||  bitsPerPixel <= 0  ||  bitsPerPixel % 8 != 0)
+    {
+        std::cerr << "Image::create:  error creating image:  " << width << "x" << height << "x" << bitsPerPixel << std::endl;
+        return false;
+    }
+    
+    return adopt(new unsigned char[width * height * (bitsPerPixel / 8)],width,height,bitsPerPixel,nullptr);
+}
+
+
+bool Image::adopt(unsigned char *data,int width,int height,int bitsPerPixel,std::function<void(void *)> release,int levels,Compression compression)
+{
+    // take over pixels a decoder allocated itself, or that are mapped from
+    // a file, so they needn't be copied.  they're freed with release, or with
+    // delete[] if that's empty.  with more than one level, the smaller levels
+    // follow the first, each half the size of the one before.  compressed
+    // pixels are in 4x4 blocks, and can only be handed to a texture
+    
+    if(!m_impl)
+        return false;
+    
+    destroy();
+    
+    
+    m_impl->data = data;
+    m_impl->release = release;
     m_impl->width = width;
     m_impl->height = height;
     m_impl->bitsPerPixel = bitsPerPixel;
+    m_impl->levels = std::max(1,levels);
+    m_impl->compression = compression;
     
-    return true;
+    return data != nullptr;
+}
+
+
+bool Image::resize(int width,int height)
+{
+    // scale the image to a new size with swscale.  it's averaged over the
+    // area each new pixel covers, which is what we want for shrinking
+    
+    if(!valid()  ||  m_impl->compression != CompressionNone)
+        return false;
+    
+    if(width == m_impl->width  &&  height == m_impl->height)
+        return true;
+    
+    
+    AVPixelFormat format = pixelFormat(m_impl->bitsPerPixel);
+    
+    if(format == AV_PIX_FMT_NONE  ||  width <= 0  ||  height <= 0)
+        return false;
+    
+    SwsContext *scaleContext = ::sws_getContext(m_impl->width,m_impl->height,format,
+                                                width,height,format,
+                                                SWS_AREA,nullptr,nullptr,nullptr);
+    
+    if(!scaleContext)
+    {
+        std::cerr << "Image::resize:  error getting scaling context" << std::endl;
+        return false;
+    }
+    
+    
+    int bytesPerPixel = m_impl->bitsPerPixel / 8;
+    unsigned char *data = new unsigned char[width * height * bytesPerPixel];
+    
+    const uint8_t *source[4] = { m_impl->data,nullptr,nullptr,nullptr };
+    int sourceLineSize[4] = { m_impl->width * bytesPerPixel,0,0,0 };
+    uint8_t *destination[4] = { data,nullptr,nullptr,nullptr };
+    int destinationLineSize[4] = { width * bytesPerPixel,0,0,0 };
+    
+    int result = ::sws_scale(scaleContext,source,sourceLineSize,0,m_impl->height,destination,destinationLineSize);
+    
+    ::sws_freeContext(scaleContext);
+    
+    if(result != height)
+    {
+        std::cerr << "Image::resize:  error scaling image" << std::endl;
+        
+        delete[] data;
+        return false;
+    }
+    
+    
+    return adopt(data,width,height,m_impl->bitsPerPixel,nullptr);
+}
+
+
+bool Image::generateLevels()
+{
+    // add the smaller levels a texture samples from when it's drawn small,
+    // each averaging 2x2 pixels of the one before, down to a single pixel.
+    // they're the same levels the GPU would make, but made here they can be
+    // kept with the image
+    
+    if(!valid()  ||  m_impl->compression != CompressionNone)
+        return false;
+    
+    if(m_impl->levels > 1)
+        return true;
+    
+    
+    int levels = 1;
+    
+    while((m_impl->width >> levels) > 0  ||  (m_impl->height >> levels) > 0)
+        ++levels;
+    
+    int bytesPerPixel = m_impl->bitsPerPixel / 8;
+    unsigned char *data = new unsigned char[size(m_impl->width,m_impl->height,m_impl->bitsPerPixel,levels)];
+    
+    memcpy(data,m_impl->data,(size_t) m_impl->width * m_impl->height * bytesPerPixel);
+    
+    unsigned char *source = data;
+    int sourceWidth = m_impl->width;
+    int sourceHeight = m_impl->height;
+    
+    for(int level = 1;level < levels;++level)
+    {
+        unsigned char *destination = source + (size_t) sourceWidth * sourceHeight * bytesPerPixel;
+        int width = std::max(1,sourceWidth / 2);
+        int height = std::max(1,sourceHeight / 2);
+        
+        for(int y = 0;y < height;++y)
+        {
+            const unsigned char *row0 = source + (size_t) std::min(2 * y,sourceHeight - 1) * sourceWidth * bytesPerPixel;
+            const unsigned char *row1 = source + (size_t) std::min(2 * y + 1,sourceHeight - 1) * sourceWidth * bytesPerPixel;
+            unsigned char *pixel = destination + (size_t) y * width * bytesPerPixel;
+            
+            for(int x = 0;x < width;++x)
+            {
+                int x0 = std::min(2 * x,sourceWidth - 1) * bytesPerPixel;
+                int x1 = std::min(2 * x + 1,sourceWidth - 1) * bytesPerPixel;
+                
+                for(int channel = 0;channel < bytesPerPixel;++channel)
+                    *pixel++ = (unsigned char) ((row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel] + 2) / 4);
+            }
+        }
+        
+        source = destination;
+        sourceWidth = width;
+        sourceHeight = height;
+    }
+    
+    return adopt(data,m_impl->width,m_impl->height,m_impl->bitsPerPixel,nullptr,levels);
 }
 
 
@@ -156,16 +380,19 @@ void Image::destroy()
     
     if(m_impl->data)
     {
-        if(m_impl->useStdDelete)
-            delete[] m_impl->data;
+        if(m_impl->release)
+            m_impl->release(m_impl->data);
         else
-            ::stbi_image_free(m_impl->data);
+            delete[] m_impl->data;
     }
     
     m_impl->data = nullptr;
+    m_impl->release = nullptr;
     m_impl->width = 0;
     m_impl->height = 0;
     m_impl->bitsPerPixel = 0;
+    m_impl->levels = 0;
+    m_impl->compression = CompressionNone;
 }
 
 
@@ -199,6 +426,48 @@ int Image::bitsPerPixel() const
 }
 
 
+int Image::levels() const
+{
+    if(!valid())
+        return 0;
+    
+    
+    return m_impl->levels;
+}
+
+
+Image::Compression Image::compression() const
+{
+    if(!valid())
+        return CompressionNone;
+    
+    
+    return m_impl->compression;
+}
+
+
+size_t Image::size() const
+{
+    // the bytes of pixels, counting every level
+    
+    if(!valid())
+        return 0;
+    
+    
+    return size(m_impl->width,m_impl->height,m_impl->bitsPerPixel,m_impl->levels,m_impl->compression);
+}
+
+
+void *Image::pixelData()
+{
+    if(!valid())
+        return nullptr;
+    
+    
+    return m_impl->data;
+}
+
+
 const void *Image::pixelData() const
 {
     if(!valid())
@@ -207,3 +476,81 @@ const void *Image::pixelData() const
     
     return m_impl->data;
 }
+
+
+const void *Image::pixelData(int level) const
+{
+    if(!valid()  ||  level < 0  ||  level >= m_impl->levels)
+        return nullptr;
+    
+    
+    return m_impl->data + size(m_impl->width,m_impl->height,m_impl->bitsPerPixel,level,m_impl->compression);
+}
+
+
+size_t Image::size(int width,int height,int bitsPerPixel,int levels,Compression compression)
+{
+    // the bytes taken by the first few levels of an image this size.  a
+    // compressed level is a whole number of 4x4 blocks, however small it is
+    
+    size_t bytes = 0;
+    
+    for(int level = 0;level < levels;++level)
+    {
+        int levelWidth = std::max(1,width >> level);
+        int levelHeight = std::max(1,height >> level);
+        
+        if(compression == CompressionNone)
+            bytes += (size_t) levelWidth * levelHeight * (bitsPerPixel / 8);
+        else
+            bytes += (size_t) ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * 16 * bitsPerPixel / 8;
+    }
+    
+    return bytes;
+}
+
+
+const char *Image::name(Compression compression)
+{
+    switch(compression)
+    {
+        case CompressionNone:   return "none";
+        case CompressionBc1:    return "bc1";
+        case CompressionBc7:    return "bc7";
+        case CompressionCount:  break;
+    }
+    
+    return "";
+}
+
+
+bool Image::setDecoder(ImageDecoder::Format format,ImageDecoder::Backend backend)
+{
+    // pick the backend for a format.  this returns false, and leaves it be,
+    // if the backend isn't built in or can't read that format
+    
+    if(format < 0  ||  format >= ImageDecoder::FormatCount)
+        return false;
+    
+    if(!ImageDecoder::available(backend)  ||  !ImageDecoder::supports(backend,format))
+    {
+        std::cerr << "Image::setDecoder:  error setting decoder:  " << ImageDecoder::name(backend) << " can't decode " << ImageDecoder::name(format) << std::endl;
+        return false;
+    }
+    
+    decoders[format] = backend + 1;
+    
+    return true;
+}
+
+
+ImageDecoder::Backend Image::decoder(ImageDecoder::Format format)
+{
+    if(format < 0  ||  format >= ImageDecoder::FormatCount)
+        return ImageDecoder::BackendStb;
+    
+    
+    int backend = decoders[format];
+    
+    return backend > 0 ? (ImageDecoder::Backend) (backend - 1) : defaultDecoder(format);
+}
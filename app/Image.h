@@ -1,9 +1,21 @@
 #pragma once
+#include <cstddef>
+#include <functional>
 #include <string>
+#include "ImageDecoder.h"
 
 
 class Image
 {
+    public:
+        enum Compression
+        {
+            CompressionNone,
+            CompressionBc1,
+            CompressionBc7,
+            CompressionCount
+        };
+        
     public:
         Image();
         ~Image();
@@ -12,14 +24,30 @@ class Image
         
         bool load(const std::string& filename);
         bool load(const unsigned char *data,int length);
+        bool loadScaled(const unsigned char *data,int length,int width);
         bool load(const unsigned char *data,int width,int height,int bitsPerPixel,bool invert = true);
+        bool create(int width,int height,int bitsPerPixel);
+        bool adopt(unsigned char *data,int width,int height,int bitsPerPixel,std::function<void(void *)> release,int levels = 1,Compression compression = CompressionNone);
+        bool resize(int width,int height);
+        bool generateLevels();
         void destroy();
         
         int width() const;
         int height() const;
         int bitsPerPixel() const;
+        int levels() const;
+        Compression compression() const;
+        size_t size() const;
         
+        void *pixelData();
         const void *pixelData() const;
+        const void *pixelData(int level) const;
+        
+        static size_t size(int width,int height,int bitsPerPixel,int levels,Compression compression = CompressionNone);
+        static const char *name(Compression compression);
+        
+        static bool setDecoder(ImageDecoder::Format format,ImageDecoder::Backend backend);
+        static ImageDecoder::Backend decoder(ImageDecoder::Format format);
         
     private:
         struct PrivateImpl;
@@ -0,0 +1,184 @@
+#include <cstring>
+#include "FfmpegImageDecoder.h"
+#include "ImageDecoder.h"
+#include "StbImageDecoder.h"
+#ifdef USE_LIBJPEG_TURBO
+#include "TurboJpegImageDecoder.h"
+#endif
+#ifdef USE_LIBPNG
+#include "LibpngImageDecoder.h"
+#endif
+#ifdef USE_LIBWEBP
+#include "LibwebpImageDecoder.h"
+#endif
+
+
+// every backend decodes an encoded image from memory into an Image, with the
+// rows bottom up the way textures want them.  given a width, a backend that
+// can decode smaller for less work does, as long as it comes out at least
+// that wide.  Image takes off whatever is left over
+//
+// stb_image and ffmpeg are always there.  the others are only there if they
+// were turned on in the build.  the backends keep no state between images, so
+// one of each is shared by every decoding thread
+
+
+ImageDecoder::Format ImageDecoder::format(const unsigned char *data,int length)
+{
+    // tell the format from the first few bytes, whatever the url or the
+    // content type says
+    
+    if(length >= 3  &&  data[0] == 0xff  &&  data[1] == 0xd8  &&  data[2] == 0xff)
+        return FormatJpeg;
+    
+    if(length >= 8  &&  memcmp(data,"\x89PNG\r\n\x1a\n",8) == 0)
+        return FormatPng;
+    
+    if(length >= 12  &&  memcmp(data,"RIFF",4) == 0  &&  memcmp(data + 8,"WEBP",4) == 0)
+        return FormatWebp;
+    
+    return FormatOther;
+}
+
+
+bool ImageDecoder::available(Backend backend)
+{
+    switch(backend)
+    {
+        case BackendStb:
+        case BackendFfmpeg:
+            return true;
+        
+        case BackendTurboJpeg:
+#ifdef USE_LIBJPEG_TURBO
+            return true;
+#else
+            return false;
+#endif
+        
+        case BackendLibpng:
+#ifdef USE_LIBPNG
+            return true;
+#else
+            return false;
+#endif
+        
+        case BackendLibwebp:
+#ifdef USE_LIBWEBP
+            return true;
+#else
+            return false;
+#endif
+        
+        case BackendCount:
+            break;
+    }
+    
+    return false;
+}
+
+
+bool ImageDecoder::supports(Backend backend,Format format)
+{
+    // stb_image reads most formats but WebP.  ffmpeg only gets the three we
+    // see from the CDN
+    
+    switch(backend)
+    {
+        case BackendStb:        return format != FormatWebp;
+        case BackendFfmpeg:     return format != FormatOther;
+        case BackendTurboJpeg:  return format == FormatJpeg;
+        case BackendLibpng:     return format == FormatPng;
+        case BackendLibwebp:    return format == FormatWebp;
+        case BackendCount:      break;
+    }
+    
+    return false;
+}
+
+
+const char *ImageDecoder::name(Backend backend)
+{
+    switch(backend)
+    {
+        case BackendStb:        return "stb";
+        case BackendFfmpeg:     return "ffmpeg";
+        case BackendTurboJpeg:  return "turbojpeg";
+        case BackendLibpng:     return "libpng";
+        case BackendLibwebp:    return "libwebp";
+        case BackendCount:      break;
+    }
+    
+    return "";
+}
+
+
+const char *ImageDecoder::name(Format format)
+{
+    switch(format)
+    {
+        case FormatJpeg:    return "jpeg";
+        case FormatPng:     return "png";
+        case FormatWebp:    return "webp";
+        case FormatOther:   return "other";
+        case FormatCount:   break;
+    }
+    
+    return "";
+}
+
+
+const ImageDecoder *ImageDecoder::get(Backend backend)
+{
+    // the shared decoder for a backend, or nullptr if it isn't built in
+    
+    switch(backend)
+    {
+        case BackendStb:
+        {
+            static const StbImageDecoder decoder;
+            return &decoder;
+        }
+        
+        case BackendFfmpeg:
+        {
+            static const FfmpegImageDecoder decoder;
+            return &decoder;
+        }
+        
+        case BackendTurboJpeg:
+        {
+#ifdef USE_LIBJPEG_TURBO
+            static const TurboJpegImageDecoder decoder;
+            return &decoder;
+#else
+            break;
+#endif
+        }
+        
+        case BackendLibpng:
+        {
+#ifdef USE_LIBPNG
+            static const LibpngImageDecoder decoder;
+            return &decoder;
+#else
+            break;
+#endif
+        }
+        
+        case BackendLibwebp:
+        {
+#ifdef USE_LIBWEBP
+            static const LibwebpImageDecoder decoder;
+            return &decoder;
+#else
+            break;
+#endif
+        }
+        
+        case BackendCount:
+            break;
+    }
+    
+    return nullptr;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+
+class Image;
+
+class ImageDecoder
+{
+    public:
+        enum Backend
+        {
+            BackendStb,
+            BackendFfmpeg,
+            BackendTurboJpeg,
+            BackendLibpng,
+            BackendLibwebp,
+            BackendCount
+        };
+        
+        enum Format
+        {
+            FormatJpeg,
+            FormatPng,
+            FormatWebp,
+            FormatOther,
+            FormatCount
+        };
+        
+    public:
+        virtual ~ImageDecoder() {}
+        
+        virtual bool decode(const unsigned char *data,int length,int width,Image& image) const = 0;
+        
+        static Format format(const unsigned char *data,int length);
+        
+        static bool available(Backend backend);
+        static bool supports(Backend backend,Format format);
+        static const char *name(Backend backend);
+        static const char *name(Format format);
+        static const ImageDecoder *get(Backend backend);
+};
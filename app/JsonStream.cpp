@@ -0,0 +1,517 @@
+#include <iostream>
+#include <vector>
+#include "JsonStream.h"
+
+
+// this is a push parser.  bytes are fed in as they arrive, in chunks of any
+// size, and the handler hears about each key, value and container as soon as
+// it's complete.  tokens split across chunks are carried over to the next
+// one, so nothing but the current token is ever buffered
+
+
+enum Expect
+{
+    ExpectValue,
+    ExpectFirstValue,
+    ExpectKey,
+    ExpectFirstKey,
+    ExpectColon,
+    ExpectSeparator,
+    ExpectEnd
+};
+
+enum Token
+{
+    TokenNone,
+    TokenString,
+    TokenEscape,
+    TokenUnicode,
+    TokenNumber,
+    TokenLiteral
+};
+
+
+static bool isWhitespace(char c)
+{
+    return c == ' '  ||  c == '\t'  ||  c == '\n'  ||  c == '\r';
+}
+
+
+static bool isNumberCharacter(char c)
+{
+    return (c >= '0'  &&  c <= '9')  ||  c == '-'  ||  c == '+'  ||  c == '.'  ||  c == 'e'  ||  c == 'E';
+}
+
+
+static int hexValue(char c)
+{
+    if(c >= '0'  &&  c <= '9')
+        return c - '0';
+    
+    if(c >= 'a'  &&  c <= 'f')
+        return c - 'a' + 10;
+    
+    if(c >= 'A'  &&  c <= 'F')
+        return c - 'A' + 10;
+    
+    return -1;
+}
+
+
+struct JsonStream::PrivateImpl
+{
+    Handler *handler;
+    
+    Expect expect;
+    Token token;
+    
+    std::string text;
+    bool textIsKey;
+    
+    unsigned int unicode;
+    int unicodeDigits;
+    unsigned int highSurrogate;
+    
+    std::vector<char> containers;
+    bool failed;
+};
+
+
+JsonStream::JsonStream(Handler *handler) :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+    {
+        m_impl->handler = handler;
+        reset();
+    }
+}
+
+
+JsonStream::~JsonStream()
+{
+    if(m_impl)
+        delete m_impl;
+}
+
+
+void JsonStream::reset()
+{
+    // start over with a new document
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->expect = ExpectValue;
+    m_impl->token = TokenNone;
+    m_impl->text.clear();
+    m_impl->textIsKey = false;
+    m_impl->unicode = 0;
+    m_impl->unicodeDigits = 0;
+    m_impl->highSurrogate = 0;
+    m_impl->containers.clear();
+    m_impl->failed = false;
+}
+
+
+bool JsonStream::feed(const char *data,size_t size)
+{
+    // parse the next chunk of the document.  this returns false once the
+    // document is found to be malformed, and ignores anything fed after that
+    
+    if(!m_impl)
+        return false;
+    
+    if(m_impl->failed)
+        return false;
+    
+    
+    Handler *handler = m_impl->handler;
+    
+    for(size_t index = 0;index < size;++index)
+    {
+        char c = data[index];
+        
+        switch(m_impl->token)
+        {
+            case TokenString:
+            {
+                // copy a run of plain characters in one go, since that's most
+                // of what's in a string
+                size_t end = index;
+                
+                while(end < size  &&  data[end] != '"'  &&  data[end] != '\\'  &&  (unsigned char) data[end] >= 0x20)
+                    ++end;
+                
+                if(end > index)
+                {
+                    flushSurrogate();
+                    m_impl->text.append(data + index,end - index);
+                    
+                    index = end;
+                    
+                    if(index == size)
+                        return true;
+                    
+                    c = data[index];
+                }
+                
+                
+                if(c == '"')
+                {
+                    flushSurrogate();
+                    m_impl->token = TokenNone;
+                    
+                    if(m_impl->textIsKey)
+                    {
+                        if(handler)
+                            handler->key(m_impl->text);
+                        
+                        m_impl->expect = ExpectColon;
+                    }
+                    else
+                    {
+                        if(handler)
+                            handler->value(ValueString,m_impl->text);
+                        
+                        endValue();
+                    }
+                }
+                else if(c == '\\')
+                {
+                    m_impl->token = TokenEscape;
+                }
+                else
+                {
+                    return fail("control character in string");
+                }
+                
+                continue;
+            }
+            
+            case TokenEscape:
+            {
+                m_impl->token = TokenString;
+                
+                if(c == 'u')
+                {
+                    m_impl->token = TokenUnicode;
+                    m_impl->unicode = 0;
+                    m_impl->unicodeDigits = 0;
+                    continue;
+                }
+                
+                flushSurrogate();
+                
+                switch(c)
+                {
+                    case '"':   m_impl->text += '"';    break;
+                    case '\\':  m_impl->text += '\\';   break;
+                    case '/':   m_impl->text += '/';    break;
+                    case 'b':   m_impl->text += '\b';   break;
+                    case 'f':   m_impl->text += '\f';   break;
+                    case 'n':   m_impl->text += '\n';   break;
+                    case 'r':   m_impl->text += '\r';   break;
+                    case 't':   m_impl->text += '\t';   break;
+                    default:    return fail("bad escape in string");
+                }
+                
+                continue;
+            }
+            
+            case TokenUnicode:
+            {
+                int digit = hexValue(c);
+                
+                if(digit < 0)
+                    return fail("bad unicode escape in string");
+                
+                m_impl->unicode = (m_impl->unicode << 4) | (unsigned int) digit;
+                
+                if(++m_impl->unicodeDigits == 4)
+                {
+                    appendCodepoint(m_impl->unicode);
+                    m_impl->token = TokenString;
+                }
+                
+                continue;
+            }
+            
+            case TokenNumber:
+            case TokenLiteral:
+            {
+                // numbers and literals have no closing character, so they end
+                // at the first character that can't be part of them.  that
+                // character is then handled like any other
+                if(m_impl->token == TokenNumber ? isNumberCharacter(c) : (c >= 'a'  &&  c <= 'z'))
+                {
+                    m_impl->text += c;
+                    continue;
+                }
+                
+                if(!endToken())
+                    return false;
+                
+                break;
+            }
+            
+            case TokenNone:
+                break;
+        }
+        
+        
+        if(isWhitespace(c))
+            continue;
+        
+        bool valueExpected = m_impl->expect == ExpectValue  ||  m_impl->expect == ExpectFirstValue;
+        
+        switch(c)
+        {
+            case '{':
+                if(!valueExpected)
+                    return fail("unexpected '{'");
+                
+                if(handler)
+                    handler->startObject();
+                
+                m_impl->containers.push_back('{');
+                m_impl->expect = ExpectFirstKey;
+                break;
+            
+            case '[':
+                if(!valueExpected)
+                    return fail("unexpected '['");
+                
+                if(handler)
+                    handler->startArray();
+                
+                m_impl->containers.push_back('[');
+                m_impl->expect = ExpectFirstValue;
+                break;
+            
+            case '}':
+                if(m_impl->containers.empty()  ||  m_impl->containers.back() != '{'  ||
+                   (m_impl->expect != ExpectFirstKey  &&  m_impl->expect != ExpectSeparator))
+                    return fail("unexpected '}'");
+                
+                m_impl->containers.pop_back();
+                
+                if(handler)
+                    handler->endObject();
+                
+                endValue();
+                break;
+            
+            case ']':
+                if(m_impl->containers.empty()  ||  m_impl->containers.back() != '['  ||
+                   (m_impl->expect != ExpectFirstValue  &&  m_impl->expect != ExpectSeparator))
+                    return fail("unexpected ']'");
+                
+                m_impl->containers.pop_back();
+                
+                if(handler)
+                    handler->endArray();
+                
+                endValue();
+                break;
+            
+            case ',':
+                if(m_impl->expect != ExpectSeparator)
+                    return fail("unexpected ','");
+                
+                m_impl->expect = m_impl->containers.back() == '{' ? ExpectKey : ExpectValue;
+                break;
+            
+            case ':':
+                if(m_impl->expect != ExpectColon)
+                    return fail("unexpected ':'");
+                
+                m_impl->expect = ExpectValue;
+                break;
+            
+            case '"':
+                if(m_impl->expect == ExpectKey  ||  m_impl->expect == ExpectFirstKey)
+                    m_impl->textIsKey = true;
+                else if(valueExpected)
+                    m_impl->textIsKey = false;
+                else
+                    return fail("unexpected string");
+                
+                m_impl->token = TokenString;
+                m_impl->text.clear();
+                break;
+            
+            default:
+                if(!valueExpected)
+                    return fail("unexpected character");
+                
+                if(c == '-'  ||  (c >= '0'  &&  c <= '9'))
+                    m_impl->token = TokenNumber;
+                else if(c == 't'  ||  c == 'f'  ||  c == 'n')
+                    m_impl->token = TokenLiteral;
+                else
+                    return fail("unexpected character");
+                
+                m_impl->text.assign(1,c);
+                break;
+        }
+    }
+    
+    return true;
+}
+
+
+bool JsonStream::finish()
+{
+    // call this at the end of the document.  it returns true if a whole
+    // document was parsed
+    
+    if(!m_impl)
+        return false;
+    
+    if(!endToken())
+        return false;
+    
+    return m_impl->token == TokenNone  &&  m_impl->expect == ExpectEnd;
+}
+
+
+bool JsonStream::failed() const
+{
+    if(!m_impl)
+        return true;
+    
+    return m_impl->failed;
+}
+
+
+bool JsonStream::endToken()
+{
+    // this function ends a number or literal, which can only be known to have
+    // ended by what follows it, or by the end of the document
+    
+    if(m_impl->failed)
+        return false;
+    
+    
+    if(m_impl->token == TokenNumber)
+    {
+        m_impl->token = TokenNone;
+        
+        if(m_impl->text == "-")
+            return fail("bad number");
+        
+        if(m_impl->handler)
+            m_impl->handler->value(ValueNumber,m_impl->text);
+        
+        endValue();
+    }
+    else if(m_impl->token == TokenLiteral)
+    {
+        m_impl->token = TokenNone;
+        
+        ValueType type;
+        
+        if(m_impl->text == "true")
+            type = ValueTrue;
+        else if(m_impl->text == "false")
+            type = ValueFalse;
+        else if(m_impl->text == "null")
+            type = ValueNull;
+        else
+            return fail("bad literal");
+        
+        if(m_impl->handler)
+            m_impl->handler->value(type,m_impl->text);
+        
+        endValue();
+    }
+    
+    return true;
+}
+
+
+void JsonStream::endValue()
+{
+    // a value just finished.  next comes a separator, or nothing at all if it
+    // was the whole document
+    
+    m_impl->expect = m_impl->containers.empty() ? ExpectEnd : ExpectSeparator;
+}
+
+
+void JsonStream::appendCodepoint(unsigned int codepoint)
+{
+    // \u escapes are UTF-16, so a character outside the basic plane arrives
+    // as a surrogate pair.  the high half is held until the low half shows up
+    
+    if(codepoint >= 0xd800  &&  codepoint <= 0xdbff)
+    {
+        flushSurrogate();
+        m_impl->highSurrogate = codepoint;
+        return;
+    }
+    
+    if(codepoint >= 0xdc00  &&  codepoint <= 0xdfff)
+    {
+        if(!m_impl->highSurrogate)
+        {
+            codepoint = 0xfffd;
+        }
+        else
+        {
+            codepoint = 0x10000 + ((m_impl->highSurrogate - 0xd800) << 10) + (codepoint - 0xdc00);
+            m_impl->highSurrogate = 0;
+        }
+    }
+    
+    flushSurrogate();
+    
+    
+    std::string& text = m_impl->text;
+    
+    if(codepoint < 0x80)
+    {
+        text += (char) codepoint;
+    }
+    else if(codepoint < 0x800)
+    {
+        text += (char) (0xc0 | (codepoint >> 6));
+        text += (char) (0x80 | (codepoint & 0x3f));
+    }
+    else if(codepoint < 0x10000)
+    {
+        text += (char) (0xe0 | (codepoint >> 12));
+        text += (char) (0x80 | ((codepoint >> 6) & 0x3f));
+        text += (char) (0x80 | (codepoint & 0x3f));
+    }
+    else
+    {
+        text += (char) (0xf0 | (codepoint >> 18));
+        text += (char) (0x80 | ((codepoint >> 12) & 0x3f));
+        text += (char) (0x80 | ((codepoint >> 6) & 0x3f));
+        text += (char) (0x80 | (codepoint & 0x3f));
+    }
+}
+
+
+void JsonStream::flushSurrogate()
+{
+    // a high surrogate that wasn't followed by a low one can't be decoded, so
+    // it becomes a replacement character
+    
+    if(!m_impl->highSurrogate)
+        return;
+    
+    m_impl->highSurrogate = 0;
+    m_impl->text += "\xef\xbf\xbd";
+}
+
+
+bool JsonStream::fail(const char *reason)
+{
+    std::cerr << "JsonStream::feed:  error parsing document:  " << reason << std::endl;
+    
+    m_impl->failed = true;
+    return false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+
+class JsonStream
+{
+    public:
+        enum ValueType
+        {
+            ValueString,
+            ValueNumber,
+            ValueTrue,
+            ValueFalse,
+            ValueNull
+        };
+        
+        class Handler
+        {
+            public:
+                virtual ~Handler() {}
+                
+                virtual void startObject() = 0;
+                virtual void endObject() = 0;
+                virtual void startArray() = 0;
+                virtual void endArray() = 0;
+                virtual void key(const std::string& key) = 0;
+                virtual void value(ValueType type,const std::string& text) = 0;
+        };
+        
+    public:
+        JsonStream(Handler *handler);
+        ~JsonStream();
+        
+        void reset();
+        
+        bool feed(const char *data,size_t size);
+        bool finish();
+        
+        bool failed() const;
+        
+    private:
+        bool endToken();
+        void endValue();
+        void appendCodepoint(unsigned int codepoint);
+        void flushSurrogate();
+        bool fail(const char *reason);
+        
+        
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
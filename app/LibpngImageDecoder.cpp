@@ -0,0 +1,48 @@
+#include <cstring>
+#include <iostream>
+#include "Image.h"
+#include "LibpngImageDecoder.h"
+#include "png.h"
+
+
+// libpng's simplified API does the conversions we'd otherwise write
+// ourselves.  palettes are expanded, 16-bit samples are brought down to 8,
+// and a negative row stride has it write the rows bottom up
+
+
+bool LibpngImageDecoder::decode(const unsigned char *data,int length,int /*width*/,Image& image) const
+{
+    png_image png;
+    memset(&png,0,sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    
+    if(!::png_image_begin_read_from_memory(&png,data,(size_t) length))
+    {
+        std::cerr << "LibpngImageDecoder::decode:  error reading header:  " << png.message << std::endl;
+        return false;
+    }
+    
+    
+    // keep gray as gray, and the alpha channel only if there is one
+    bool color = (png.format & PNG_FORMAT_FLAG_COLOR) != 0;
+    bool alpha = (png.format & PNG_FORMAT_FLAG_ALPHA) != 0;
+    
+    if(color)
+        png.format = alpha ? PNG_FORMAT_RGBA : PNG_FORMAT_RGB;
+    else
+        png.format = alpha ? PNG_FORMAT_GA : PNG_FORMAT_GRAY;
+    
+    if(!image.create((int) png.width,(int) png.height,8 * PNG_IMAGE_PIXEL_SIZE(png.format)))
+    {
+        ::png_image_free(&png);
+        return false;
+    }
+    
+    if(!::png_image_finish_read(&png,nullptr,image.pixelData(),-(int) PNG_IMAGE_ROW_STRIDE(png),nullptr))
+    {
+        std::cerr << "LibpngImageDecoder::decode:  error decoding image:  " << png.message << std::endl;
+        return false;
+    }
+    
+    return true;
+}
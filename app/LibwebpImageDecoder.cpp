@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include "Image.h"
+#include "LibwebpImageDecoder.h"
+#include "webp/decode.h"
+
+
+// libwebp can scale while it decodes, and flip the rows the way textures
+// want, so it writes straight into the image at the size we draw it
+
+
+bool LibwebpImageDecoder::decode(const unsigned char *data,int length,int width,Image& image) const
+{
+    WebPDecoderConfig config;
+    
+    if(!::WebPInitDecoderConfig(&config))
+        return false;
+    
+    if(::WebPGetFeatures(data,(size_t) length,&config.input) != VP8_STATUS_OK)
+    {
+        std::cerr << "LibwebpImageDecoder::decode:  error reading header" << std::endl;
+        return false;
+    }
+    
+    
+    int imageWidth = config.input.width;
+    int imageHeight = config.input.height;
+    
+    if(width > 0  &&  imageWidth > width)
+    {
+        imageHeight = std::max(1,(int) std::lround((double) imageHeight * width / imageWidth));
+        imageWidth = width;
+        
+        config.options.use_scaling = 1;
+        config.options.scaled_width = imageWidth;
+        config.options.scaled_height = imageHeight;
+    }
+    
+    // keep the alpha channel only if there is one
+    bool alpha = config.input.has_alpha != 0;
+    int bitsPerPixel = alpha ? 32 : 24;
+    
+    if(!image.create(imageWidth,imageHeight,bitsPerPixel))
+        return false;
+    
+    config.options.flip = 1;
+    config.output.colorspace = alpha ? MODE_RGBA : MODE_RGB;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba = (uint8_t *) image.pixelData();
+    config.output.u.RGBA.stride = imageWidth * bitsPerPixel / 8;
+    config.output.u.RGBA.size = (size_t) config.output.u.RGBA.stride * imageHeight;
+    
+    VP8StatusCode status = ::WebPDecode(data,(size_t) length,&config);
+    
+    ::WebPFreeDecBuffer(&config.output);
+    
+    if(status != VP8_STATUS_OK)
+    {
+        std::cerr << "LibwebpImageDecoder::decode:  error decoding image:  " << status << std::endl;
+        return false;
+    }
+    
+    return true;
+}
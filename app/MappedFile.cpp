@@ -0,0 +1,183 @@
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "MappedFile.h"
+
+
+// a read-only view of a whole file.  the pages are only read in as they're
+// touched, so opening even a large file costs next to nothing
+
+
+struct MappedFile::PrivateImpl
+{
+    const char *data;
+    size_t size;
+    
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+};
+
+
+MappedFile::MappedFile() :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+    {
+        m_impl->data = nullptr;
+        m_impl->size = 0;
+        
+#ifdef _WIN32
+        m_impl->file = INVALID_HANDLE_VALUE;
+        m_impl->mapping = nullptr;
+#else
+        m_impl->file = -1;
+#endif
+    }
+}
+
+
+MappedFile::~MappedFile()
+{
+    if(m_impl)
+    {
+        close();
+        delete m_impl;
+    }
+}
+
+
+bool MappedFile::valid() const
+{
+    if(!m_impl)
+        return false;
+    
+    return m_impl->data != nullptr;
+}
+
+
+bool MappedFile::open(const std::string& filename)
+{
+    // map the file.  an empty file can't be mapped, so it fails like a
+    // missing one
+    
+    if(!m_impl)
+        return false;
+    
+    close();
+    
+    
+#ifdef _WIN32
+    m_impl->file = ::CreateFileA(filename.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+    
+    if(m_impl->file == INVALID_HANDLE_VALUE)
+        return false;
+    
+    LARGE_INTEGER size;
+    
+    if(!::GetFileSizeEx(m_impl->file,&size)  ||  size.QuadPart <= 0)
+    {
+        close();
+        return false;
+    }
+    
+    m_impl->mapping = ::CreateFileMappingA(m_impl->file,nullptr,PAGE_READONLY,0,0,nullptr);
+    
+    if(m_impl->mapping)
+        m_impl->data = (const char *) ::MapViewOfFile(m_impl->mapping,FILE_MAP_READ,0,0,0);
+    
+    m_impl->size = (size_t) size.QuadPart;
+#else
+    m_impl->file = ::open(filename.c_str(),O_RDONLY);
+    
+    if(m_impl->file < 0)
+        return false;
+    
+    struct stat status;
+    
+    if(::fstat(m_impl->file,&status) != 0  ||  status.st_size <= 0)
+    {
+        close();
+        return false;
+    }
+    
+    void *data = ::mmap(nullptr,(size_t) status.st_size,PROT_READ,MAP_PRIVATE,m_impl->file,0);
+    
+    if(data != MAP_FAILED)
+        m_impl->data = (const char *) data;
+    
+    m_impl->size = (size_t) status.st_size;
+#endif
+    
+    
+    if(!m_impl->data)
+    {
+        std::cerr << "MappedFile::open:  error mapping '" << filename << "'" << std::endl;
+        
+        close();
+        return false;
+    }
+    
+    return true;
+}
+
+
+void MappedFile::close()
+{
+    if(!m_impl)
+        return;
+    
+#ifdef _WIN32
+    if(m_impl->data)
+        ::UnmapViewOfFile(m_impl->data);
+    
+    if(m_impl->mapping)
+        ::CloseHandle(m_impl->mapping);
+    
+    if(m_impl->file != INVALID_HANDLE_VALUE)
+        ::CloseHandle(m_impl->file);
+    
+    m_impl->file = INVALID_HANDLE_VALUE;
+    m_impl->mapping = nullptr;
+#else
+    if(m_impl->data)
+        ::munmap((void *) m_impl->data,m_impl->size);
+    
+    if(m_impl->file >= 0)
+        ::close(m_impl->file);
+    
+    m_impl->file = -1;
+#endif
+    
+    m_impl->data = nullptr;
+    m_impl->size = 0;
+}
+
+
+const char *MappedFile::data() const
+{
+    if(!m_impl)
+        return nullptr;
+    
+    return m_impl->data;
+}
+
+
+size_t MappedFile::size() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->size;
+}
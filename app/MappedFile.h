@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+
+class MappedFile
+{
+    public:
+        MappedFile();
+        ~MappedFile();
+        
+        bool valid() const;
+        
+        bool open(const std::string& filename);
+        void close();
+        
+        const char *data() const;
+        size_t size() const;
+        
+    private:
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -0,0 +1,209 @@
+#include <list>
+#include "Residency.h"
+
+
+// keeps count of the bytes a set of assets holds, and which of them was used
+// least recently, so they can be let go of to stay under a budget.  the keys
+// are whatever the owner tracks its assets by.  anything used since the frame
+// began is never evicted, so what's on screen stays, even if it alone is over
+// the budget.  the owner does the letting go, and this isn't locked, so it's
+// used under the owner's lock
+
+
+struct Asset
+{
+    uint32_t key;
+    size_t bytes;
+    unsigned frame;
+};
+
+
+struct Residency::PrivateImpl
+{
+    // most recently used first
+    std::list<Asset> assets;
+    std::unordered_map<uint32_t,std::list<Asset>::iterator> index;
+    
+    size_t budget;
+    size_t usage;
+    unsigned frame;
+};
+
+
+Residency::Residency() :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+    {
+        m_impl->budget = 0;
+        m_impl->usage = 0;
+        m_impl->frame = 0;
+    }
+}
+
+
+Residency::~Residency()
+{
+    if(m_impl)
+        delete m_impl;
+}
+
+
+void Residency::setBudget(size_t budget)
+{
+    // the most bytes to hold before evicting, or 0 for no limit
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->budget = budget;
+}
+
+
+size_t Residency::budget() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->budget;
+}
+
+
+size_t Residency::usage() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->usage;
+}
+
+
+size_t Residency::count() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->assets.size();
+}
+
+
+void Residency::nextFrame()
+{
+    // everything used so far can be evicted from here on
+    
+    if(!m_impl)
+        return;
+    
+    ++m_impl->frame;
+}
+
+
+void Residency::use(uint32_t key,size_t bytes)
+{
+    // note that an asset was used this frame, adding it if it's new.  its size
+    // is updated in case it's been replaced
+    
+    if(!m_impl)
+        return;
+    
+    auto assetIndex = m_impl->index.find(key);
+    
+    if(assetIndex != m_impl->index.end())
+    {
+        m_impl->usage -= assetIndex->second->bytes;
+        m_impl->assets.splice(m_impl->assets.begin(),m_impl->assets,assetIndex->second);
+    }
+    else
+    {
+        m_impl->assets.push_front(Asset());
+        m_impl->index[key] = m_impl->assets.begin();
+    }
+    
+    Asset& asset = m_impl->assets.front();
+    asset.key = key;
+    asset.bytes = bytes;
+    asset.frame = m_impl->frame;
+    
+    m_impl->usage += bytes;
+}
+
+
+void Residency::erase(uint32_t key)
+{
+    // forget an asset the owner let go of itself
+    
+    if(!m_impl)
+        return;
+    
+    auto assetIndex = m_impl->index.find(key);
+    
+    if(assetIndex == m_impl->index.end())
+        return;
+    
+    m_impl->usage -= assetIndex->second->bytes;
+    m_impl->assets.erase(assetIndex->second);
+    m_impl->index.erase(assetIndex);
+}
+
+
+bool Residency::evict(uint32_t& key)
+{
+    // while over the budget, take the least recently used asset that wasn't
+    // used this frame and return its key, for the owner to let go of.  this
+    // returns false once under the budget, or if everything left is in use
+    
+    if(!m_impl  ||  m_impl->budget == 0  ||  m_impl->usage <= m_impl->budget  ||  m_impl->assets.empty())
+        return false;
+    
+    const Asset& asset = m_impl->assets.back();
+    
+    if(asset.frame == m_impl->frame)
+        return false;
+    
+    key = asset.key;
+    
+    m_impl->usage -= asset.bytes;
+    m_impl->index.erase(key);
+    m_impl->assets.pop_back();
+    
+    return true;
+}
+
+
+void Residency::remap(const std::unordered_map<uint32_t,uint32_t>& keys)
+{
+    // move every asset to a new key, keeping the order they were used in.
+    // any without a new key are forgotten
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->index.clear();
+    
+    for(auto asset = m_impl->assets.begin();asset != m_impl->assets.end();)
+    {
+        auto keyIndex = keys.find(asset->key);
+        
+        if(keyIndex == keys.end())
+        {
+            m_impl->usage -= asset->bytes;
+            asset = m_impl->assets.erase(asset);
+            continue;
+        }
+        
+        asset->key = keyIndex->second;
+        m_impl->index[asset->key] = asset;
+        ++asset;
+    }
+}
+
+
+void Residency::clear()
+{
+    if(!m_impl)
+        return;
+    
+    m_impl->assets.clear();
+    m_impl->index.clear();
+    m_impl->usage = 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+
+class Residency
+{
+    public:
+        Residency();
+        ~Residency();
+        
+        void setBudget(size_t budget);
+        size_t budget() const;
+        size_t usage() const;
+        size_t count() const;
+        
+        void nextFrame();
+        
+        void use(uint32_t key,size_t bytes);
+        void erase(uint32_t key);
+        bool evict(uint32_t& key);
+        
+        void remap(const std::unordered_map<uint32_t,uint32_t>& keys);
+        void clear();
+        
+    private:
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+
+// values are written in the host's byte order and layout.  a file made of
+// them should record the byte order it was written in, and not be read on a
+// host that doesn't match
+
+template<typename T>
+inline void writeValue(std::string& out,const T& value)
+{
+    out.append((const char *) &value,sizeof(value));
+}
+
+
+inline void writeBytes(std::string& out,const char *data,size_t size)
+{
+    out.append(data,size);
+}
+
+
+template<typename T>
+inline bool readValue(const char *&data,const char *end,T& value)
+{
+    // read a value and move past it.  this returns false if there isn't one
+    // whole value left
+    
+    if((size_t) (end - data) < sizeof(value))
+        return false;
+    
+    memcpy(&value,data,sizeof(value));
+    data += sizeof(value);
+    
+    return true;
+}
+
+
+inline bool readBytes(const char *&data,const char *end,size_t size,const char *&bytes)
+{
+    // point bytes at the next size bytes and move past them
+    
+    if((size_t) (end - data) < size)
+        return false;
+    
+    bytes = data;
+    data += size;
+    
+    return true;
+}
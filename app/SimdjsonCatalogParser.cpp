@@ -0,0 +1,348 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include "SimdjsonCatalogParser.h"
+#include "simdjson.h"
+
+
+// this backend collects the whole document and walks it with simdjson's
+// on-demand API, which parses values only as they're visited and skips
+// everything else at SIMD speed.  on-demand values can only be visited once
+// and in document order, so objects with more than one member we want are
+// walked member by member rather than looked up key by key.  that includes a
+// set document's sets, which are put back in key order afterwards to match
+// the DOM parser's sorted objects
+
+
+typedef simdjson::simdjson_result<simdjson::ondemand::value> Value;
+
+
+static bool missing(simdjson::error_code error)
+{
+    // a value that isn't there, or isn't the type we're after, is skipped the
+    // way the DOM parser skips it.  anything else means the document is bad
+    return error == simdjson::NO_SUCH_FIELD  ||  error == simdjson::INCORRECT_TYPE;
+}
+
+
+static std::string text(Value value)
+{
+    std::string_view view;
+    
+    if(value.get_string().get(view))
+        return std::string();
+    
+    return std::string(view.data(),view.size());
+}
+
+
+static std::string firstMemberText(Value value,const char *key)
+{
+    // take the member of an object with the smallest key, like the DOM
+    // parser's front(), and return the string at default.<key> inside it
+    
+    simdjson::ondemand::object object;
+    
+    if(value.get_object().get(object))
+        return std::string();
+    
+    
+    std::string result;
+    std::string resultKey;
+    bool found = false;
+    
+    for(auto member : object)
+    {
+        std::string_view memberKey;
+        
+        if(member.unescaped_key().get(memberKey))
+            break;
+        
+        std::string name(memberKey.data(),memberKey.size());
+        
+        if(found  &&  name >= resultKey)
+            continue;
+        
+        result = text(Value(member.value()).find_field_unordered("default").find_field_unordered(key));
+        resultKey = name;
+        found = true;
+    }
+    
+    return result;
+}
+
+
+static Tile parseTile(simdjson::ondemand::object& item)
+{
+    Tile tile;
+    
+    for(auto member : item)
+    {
+        std::string_view key;
+        
+        if(member.unescaped_key().get(key))
+            break;
+        
+        Value value(member.value());
+        
+        if(key == "text")
+            tile.name = firstMemberText(value.find_field_unordered("title").find_field_unordered("full"),"content");
+        else if(key == "image")
+            tile.url = firstMemberText(value.find_field_unordered("tile").find_field_unordered("1.78"),"url");
+        else if(key == "ratings")
+            tile.rating = text(value.get_array().at(0).find_field_unordered("value"));
+        else if(key == "releases")
+            tile.releaseDate = text(value.get_array().at(0).find_field_unordered("releaseDate"));
+        else if(key == "videoArt")
+            tile.videoUrl = text(value.get_array().at(0).find_field_unordered("mediaMetadata").find_field_unordered("urls").get_array().at(0).find_field_unordered("url"));
+    }
+    
+    return tile;
+}
+
+
+static bool parseSet(Value value,TileTable& tiles,std::vector<TileSet>& tileSets)
+{
+    // a SetRef has no items of its own.  it's left as an empty row for the
+    // worker to fill in from its own document.  we can't know which it is
+    // until we've seen the type, which may come after the items
+    
+    simdjson::ondemand::object set;
+    simdjson::error_code error = value.get_object().get(set);
+    
+    if(error)
+        return missing(error);
+    
+    
+    TileSet tileSet;
+    tileSet.columnOffset = 0;
+    
+    std::string type;
+    
+    for(auto member : set)
+    {
+        std::string_view key;
+        
+        if(member.unescaped_key().get(key))
+            return false;
+        
+        Value memberValue(member.value());
+        
+        if(key == "type")
+        {
+            type = text(memberValue);
+        }
+        else if(key == "refId")
+        {
+            tileSet.refId = text(memberValue);
+        }
+        else if(key == "text")
+        {
+            tileSet.name = text(memberValue.find_field_unordered("title").find_field_unordered("full").find_field_unordered("set").find_field_unordered("default").find_field_unordered("content"));
+        }
+        else if(key == "items")
+        {
+            simdjson::ondemand::array items;
+            
+            error = memberValue.get_array().get(items);
+            
+            if(missing(error))
+                continue;
+            else if(error)
+                return false;
+            
+            for(auto itemResult : items)
+            {
+                simdjson::ondemand::object item;
+                
+                error = itemResult.get_object().get(item);
+                
+                if(missing(error))
+                    continue;
+                else if(error)
+                    return false;
+                
+                tileSet.tiles.push_back(tiles.add(parseTile(item)));
+            }
+        }
+    }
+    
+    
+    tileSet.loaded = type != "SetRef";
+    
+    if(tileSet.loaded)
+        tileSet.refId.clear();
+    else
+        tileSet.tiles.clear();
+    
+    tileSets.push_back(std::move(tileSet));
+    
+    return true;
+}
+
+
+struct SimdjsonCatalogParser::PrivateImpl
+{
+    Document document;
+    std::string buffer;
+    std::vector<TileSet> tileSets;
+    TileTable tiles;
+    
+    simdjson::ondemand::parser parser;
+};
+
+
+SimdjsonCatalogParser::SimdjsonCatalogParser(Document document) :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+        m_impl->document = document;
+}
+
+
+SimdjsonCatalogParser::~SimdjsonCatalogParser()
+{
+    if(m_impl)
+        delete m_impl;
+}
+
+
+void SimdjsonCatalogParser::reset()
+{
+    if(!m_impl)
+        return;
+    
+    m_impl->buffer.clear();
+    m_impl->tileSets.clear();
+    m_impl->tiles.clear();
+}
+
+
+bool SimdjsonCatalogParser::feed(const char *data,size_t size)
+{
+    if(!m_impl)
+        return false;
+    
+    m_impl->buffer.append(data,size);
+    
+    return true;
+}
+
+
+bool SimdjsonCatalogParser::finish()
+{
+    if(!m_impl)
+        return false;
+    
+    
+    // the buffer is only needed until the walk is done, whether or not it
+    // gets to the end
+    bool ok = parse();
+    
+    std::string().swap(m_impl->buffer);
+    
+    return ok;
+}
+
+
+bool SimdjsonCatalogParser::parse()
+{
+    // simdjson reads past the end of the document, so the buffer needs some
+    // padding.  reserving it saves copying into a padded_string
+    m_impl->buffer.reserve(m_impl->buffer.size() + simdjson::SIMDJSON_PADDING);
+    
+    simdjson::ondemand::document document;
+    simdjson::padded_string_view json(m_impl->buffer.data(),m_impl->buffer.size(),m_impl->buffer.capacity());
+    
+    if(m_impl->parser.iterate(json).get(document))
+    {
+        std::cerr << "SimdjsonCatalogParser::finish:  error parsing document" << std::endl;
+        return false;
+    }
+    
+    
+    if(m_impl->document == HomeDocument)
+    {
+        simdjson::ondemand::array containers;
+        simdjson::error_code error = document.find_field_unordered("data").find_field_unordered("StandardCollection").find_field_unordered("containers").get_array().get(containers);
+        
+        if(missing(error))
+            return true;
+        
+        if(error)
+        {
+            std::cerr << "SimdjsonCatalogParser::finish:  error finding containers:  " << simdjson::error_message(error) << std::endl;
+            return false;
+        }
+        
+        
+        for(auto container : containers)
+        {
+            Value set = container.find_field_unordered("set");
+            
+            if(missing(set.error()))
+                continue;
+            
+            if(set.error()  ||  !parseSet(set,m_impl->tiles,m_impl->tileSets))
+            {
+                std::cerr << "SimdjsonCatalogParser::finish:  error parsing container" << std::endl;
+                return false;
+            }
+        }
+    }
+    else
+    {
+        simdjson::ondemand::object data;
+        simdjson::error_code error = document.find_field_unordered("data").get_object().get(data);
+        
+        if(missing(error))
+            return true;
+        
+        if(error)
+        {
+            std::cerr << "SimdjsonCatalogParser::finish:  error finding data:  " << simdjson::error_message(error) << std::endl;
+            return false;
+        }
+        
+        
+        std::vector<std::string> keys;
+        
+        for(auto member : data)
+        {
+            std::string_view key;
+            size_t count = m_impl->tileSets.size();
+            
+            if(member.unescaped_key().get(key)  ||  !parseSet(member.value(),m_impl->tiles,m_impl->tileSets))
+            {
+                std::cerr << "SimdjsonCatalogParser::finish:  error parsing set" << std::endl;
+                return false;
+            }
+            
+            if(m_impl->tileSets.size() == count)
+                continue;
+            
+            std::string name(key.data(),key.size());
+            auto position = std::upper_bound(keys.begin(),keys.end(),name);
+            
+            std::rotate(m_impl->tileSets.begin() + (position - keys.begin()),m_impl->tileSets.end() - 1,m_impl->tileSets.end());
+            keys.insert(position,name);
+        }
+    }
+    
+    return true;
+}
+
+
+std::vector<TileSet> SimdjsonCatalogParser::takeTileSets(TileTable& tiles)
+{
+    if(!m_impl)
+        return std::vector<TileSet>();
+    
+    std::vector<TileSet> tileSets;
+    tileSets.swap(m_impl->tileSets);
+    
+    tiles.swap(m_impl->tiles);
+    m_impl->tiles.clear();
+    
+    return tileSets;
+}
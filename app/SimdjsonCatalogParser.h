@@ -0,0 +1,23 @@
+#pragma once
+#include "CatalogParser.h"
+
+
+class SimdjsonCatalogParser : public CatalogParser
+{
+    public:
+        SimdjsonCatalogParser(Document document);
+        ~SimdjsonCatalogParser();
+        
+        void reset();
+        
+        bool feed(const char *data,size_t size);
+        bool finish();
+        
+        std::vector<TileSet> takeTileSets(TileTable& tiles);
+        
+    private:
+        bool parse();
+        
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -0,0 +1,32 @@
+#include <iostream>
+#include "Image.h"
+#include "StbImageDecoder.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+
+// stb_image reads just about anything but WebP, and is always there, so it's
+// the fallback for whatever the other backends can't read.  it only ever
+// decodes in full
+
+
+bool StbImageDecoder::decode(const unsigned char *data,int length,int /*width*/,Image& image) const
+{
+    // images are decoded on several threads at once, so the flip is set for
+    // this thread only rather than for everyone
+    
+    ::stbi_set_flip_vertically_on_load_thread(true);
+    
+    
+    int imageWidth,imageHeight,bytes;
+    unsigned char *pixels = ::stbi_load_from_memory(data,length,&imageWidth,&imageHeight,&bytes,0);
+    
+    if(!pixels)
+    {
+        std::cerr << "StbImageDecoder::decode:  error decoding image:  " << stbi_failure_reason() << std::endl;
+        return false;
+    }
+    
+    return image.adopt(pixels,imageWidth,imageHeight,8 * bytes,::stbi_image_free);
+}
@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include "JsonStream.h"
+#include "StreamCatalogParser.h"
+
+
+// the catalog documents are parsed as they stream in.  rather than building a
+// DOM and walking it afterwards, we keep track of where we are in the document
+// and pick out the handful of values a tile or row needs as they go by.  a row
+// is complete, and is added to the list, as soon as its set object closes
+//
+// the paths are the same ones the DOM parser follows.  a home document has
+// its sets at data.StandardCollection.containers[].set, and a set document has
+// its set at data.<type>.  where the DOM parser takes the front() of an
+// object whose key varies, we take the value under the smallest key, since
+// that's what front() returns from nlohmann's sorted objects.  for the same
+// reason, a set document with more than one set has its rows in key order
+// rather than the order they appear in
+
+
+struct Frame
+{
+    bool array;
+    int index;
+    std::string key;
+};
+
+
+static bool matchPath(const std::vector<Frame>& path,size_t start,std::initializer_list<const char *> pattern,std::string *wildcard = nullptr)
+{
+    // compare the path from start onwards with a pattern.  "*" matches any
+    // key, and hands it back through wildcard.  "[]" matches any array index
+    // and "[0]" only the first
+    
+    if(path.size() - start != pattern.size())
+        return false;
+    
+    size_t index = start;
+    
+    for(const char *component : pattern)
+    {
+        const Frame& frame = path[index++];
+        
+        if(component[0] == '[')
+        {
+            if(!frame.array  ||  (component[1] == '0'  &&  frame.index != 0))
+                return false;
+        }
+        else if(frame.array)
+        {
+            return false;
+        }
+        else if(component[0] == '*'  &&  component[1] == '\0')
+        {
+            if(wildcard)
+                *wildcard = frame.key;
+        }
+        else if(frame.key != component)
+        {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+
+static void takeSmallest(std::string& target,std::string& targetKey,const std::string& key,const std::string& value)
+{
+    if(target.empty()  ||  key < targetKey)
+    {
+        target = value;
+        targetKey = key;
+    }
+}
+
+
+class CatalogHandler : public JsonStream::Handler
+{
+    public:
+        CatalogHandler(CatalogParser::Document document) :
+            m_document(document)
+        {
+            reset();
+        }
+        
+        void reset()
+        {
+            m_path.clear();
+            m_setDepth = -1;
+            m_tileDepth = -1;
+            m_tileSets.clear();
+            m_setKeys.clear();
+            m_tiles.clear();
+        }
+        
+        std::vector<TileSet>& tileSets()
+        {
+            return m_tileSets;
+        }
+        
+        TileTable& tiles()
+        {
+            return m_tiles;
+        }
+        
+        void startObject()
+        {
+            beginValue();
+            
+            
+            size_t depth = m_path.size();
+            
+            if(m_setDepth < 0)
+            {
+                bool setRoot = m_document == CatalogParser::HomeDocument ?
+                               matchPath(m_path,0,{ "data","StandardCollection","containers","[]","set" }) :
+                               matchPath(m_path,0,{ "data","*" },&m_setKey);
+                
+                if(setRoot)
+                {
+                    m_setDepth = (int) depth;
+                    
+                    m_tileSet = TileSet();
+                    m_tileSet.columnOffset = 0;
+                    m_tileSet.loaded = true;
+                    m_setType.clear();
+                }
+            }
+            else if(m_tileDepth < 0  &&  matchPath(m_path,m_setDepth,{ "items","[]" }))
+            {
+                m_tileDepth = (int) depth;
+                
+                // the strings are cleared rather than replaced, so their
+                // buffers are reused from one tile to the next
+                m_tile.name.clear();
+                m_tile.releaseDate.clear();
+                m_tile.rating.clear();
+                m_tile.url.clear();
+                m_tile.videoUrl.clear();
+                m_tileNameKey.clear();
+                m_tileUrlKey.clear();
+            }
+            
+            m_path.push_back(Frame());
+            m_path.back().array = false;
+            m_path.back().index = -1;
+        }
+        
+        void endObject()
+        {
+            m_path.pop_back();
+            
+            
+            if((int) m_path.size() == m_tileDepth)
+            {
+                m_tileSet.tiles.push_back(m_tiles.add(m_tile));
+                m_tileDepth = -1;
+            }
+            else if((int) m_path.size() == m_setDepth)
+            {
+                // a SetRef has no items of its own.  it's left as an empty row
+                // for the worker to fill in from its own document
+                if(m_setType == "SetRef")
+                {
+                    m_tileSet.tiles.clear();
+                    m_tileSet.loaded = false;
+                }
+                else
+                {
+                    m_tileSet.refId.clear();
+                }
+                
+                if(m_document == CatalogParser::SetDocument)
+                {
+                    auto position = std::upper_bound(m_setKeys.begin(),m_setKeys.end(),m_setKey);
+                    
+                    m_tileSets.insert(m_tileSets.begin() + (position - m_setKeys.begin()),std::move(m_tileSet));
+                    m_setKeys.insert(position,m_setKey);
+                }
+                else
+                {
+                    m_tileSets.push_back(std::move(m_tileSet));
+                }
+                
+                m_setDepth = -1;
+            }
+        }
+        
+        void startArray()
+        {
+            beginValue();
+            
+            m_path.push_back(Frame());
+            m_path.back().array = true;
+            m_path.back().index = -1;
+        }
+        
+        void endArray()
+        {
+            m_path.pop_back();
+        }
+        
+        void key(const std::string& key)
+        {
+            m_path.back().key = key;
+        }
+        
+        void value(JsonStream::ValueType type,const std::string& text)
+        {
+            beginValue();
+            
+            if(m_setDepth < 0  ||  type != JsonStream::ValueString)
+                return;
+            
+            
+            std::string wildcard;
+            
+            if(m_tileDepth >= 0)
+            {
+                size_t start = m_tileDepth;
+                
+                if(matchPath(m_path,start,{ "text","title","full","*","default","content" },&wildcard))
+                    takeSmallest(m_tile.name,m_tileNameKey,wildcard,text);
+                else if(matchPath(m_path,start,{ "image","tile","1.78","*","default","url" },&wildcard))
+                    takeSmallest(m_tile.url,m_tileUrlKey,wildcard,text);
+                else if(matchPath(m_path,start,{ "ratings","[0]","value" }))
+                    m_tile.rating = text;
+                else if(matchPath(m_path,start,{ "releases","[0]","releaseDate" }))
+                    m_tile.releaseDate = text;
+                else if(matchPath(m_path,start,{ "videoArt","[0]","mediaMetadata","urls","[0]","url" }))
+                    m_tile.videoUrl = text;
+            }
+            else
+            {
+                size_t start = m_setDepth;
+                
+                if(matchPath(m_path,start,{ "type" }))
+                    m_setType = text;
+                else if(matchPath(m_path,start,{ "refId" }))
+                    m_tileSet.refId = text;
+                else if(matchPath(m_path,start,{ "text","title","full","set","default","content" }))
+                    m_tileSet.name = text;
+            }
+        }
+        
+    private:
+        void beginValue()
+        {
+            // a value inside an array moves it on to the next index
+            if(!m_path.empty()  &&  m_path.back().array)
+                ++m_path.back().index;
+        }
+        
+        
+        CatalogParser::Document m_document;
+        std::vector<Frame> m_path;
+        
+        int m_setDepth;
+        TileSet m_tileSet;
+        std::string m_setType;
+        std::string m_setKey;
+        
+        int m_tileDepth;
+        Tile m_tile;
+        std::string m_tileNameKey;
+        std::string m_tileUrlKey;
+        
+        std::vector<TileSet> m_tileSets;
+        std::vector<std::string> m_setKeys;
+        TileTable m_tiles;
+};
+
+
+struct StreamCatalogParser::PrivateImpl
+{
+    PrivateImpl(Document document) :
+        handler(document),
+        stream(&handler)
+    {
+    }
+    
+    CatalogHandler handler;
+    JsonStream stream;
+};
+
+
+StreamCatalogParser::StreamCatalogParser(Document document) :
+    m_impl(new PrivateImpl(document))
+{
+}
+
+
+StreamCatalogParser::~StreamCatalogParser()
+{
+    if(m_impl)
+        delete m_impl;
+}
+
+
+void StreamCatalogParser::reset()
+{
+    // throw away anything parsed so far and start on a new document.  this is
+    // needed when a transfer is restarted part way through
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->stream.reset();
+    m_impl->handler.reset();
+}
+
+
+bool StreamCatalogParser::feed(const char *data,size_t size)
+{
+    if(!m_impl)
+        return false;
+    
+    return m_impl->stream.feed(data,size);
+}
+
+
+bool StreamCatalogParser::finish()
+{
+    // call this once the whole document has been fed in.  it returns false if
+    // the document was malformed or cut short
+    
+    if(!m_impl)
+        return false;
+    
+    if(!m_impl->stream.finish())
+    {
+        std::cerr << "StreamCatalogParser::finish:  error parsing document" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+
+std::vector<TileSet> StreamCatalogParser::takeTileSets(TileTable& tiles)
+{
+    // move the rows out to the caller, in the order the DOM parser would find
+    // them, along with the table their tiles were added to
+    
+    if(!m_impl)
+        return std::vector<TileSet>();
+    
+    std::vector<TileSet> tileSets;
+    tileSets.swap(m_impl->handler.tileSets());
+    
+    tiles.swap(m_impl->handler.tiles());
+    m_impl->handler.tiles().clear();
+    
+    return tileSets;
+}
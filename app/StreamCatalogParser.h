@@ -0,0 +1,21 @@
+#pragma once
+#include "CatalogParser.h"
+
+
+class StreamCatalogParser : public CatalogParser
+{
+    public:
+        StreamCatalogParser(Document document);
+        ~StreamCatalogParser();
+        
+        void reset();
+        
+        bool feed(const char *data,size_t size);
+        bool finish();
+        
+        std::vector<TileSet> takeTileSets(TileTable& tiles);
+        
+    private:
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "Serialization.h"
+#include "StringPool.h"
+
+
+// strings are copied into large blocks, so thousands of them cost a handful
+// of allocations and sit next to each other in memory.  each distinct string
+// is kept once and handed out by id.  the ids are dense, starting from 0 for
+// the empty string, and stay valid until the pool is cleared
+
+
+static const size_t firstBlockSize = 4 * 1024;
+static const size_t blockSize = 64 * 1024;
+
+
+struct Entry
+{
+    const char *data;
+    uint32_t size;
+    uint32_t hash;
+};
+
+
+static uint32_t hashText(const char *text,size_t size)
+{
+    // FNV-1a
+    
+    uint32_t hash = 2166136261u;
+    
+    for(size_t index = 0;index < size;++index)
+    {
+        hash ^= (unsigned char) text[index];
+        hash *= 16777619u;
+    }
+    
+    return hash;
+}
+
+
+struct StringPool::PrivateImpl
+{
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char *blockData;
+    size_t blockRemaining;
+    size_t blockBytes;
+    
+    std::vector<Entry> entries;
+    
+    // open addressed, with 0 marking an empty slot.  the empty string is
+    // never looked up, so it doesn't need one
+    std::vector<Id> slots;
+};
+
+
+StringPool::StringPool() :
+    m_impl(new PrivateImpl)
+{
+    clear();
+}
+
+
+StringPool::~StringPool()
+{
+    if(m_impl)
+        delete m_impl;
+}
+
+
+void StringPool::clear()
+{
+    // forget every string.  ids handed out before this are no longer valid
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->blocks.clear();
+    m_impl->blockData = nullptr;
+    m_impl->blockRemaining = 0;
+    m_impl->blockBytes = 0;
+    
+    Entry empty;
+    empty.data = "";
+    empty.size = 0;
+    empty.hash = 0;
+    
+    m_impl->entries.assign(1,empty);
+    m_impl->slots.assign(256,0);
+}
+
+
+void StringPool::swap(StringPool& other)
+{
+    std::swap(m_impl,other.m_impl);
+}
+
+
+StringPool::Id StringPool::intern(const char *text,size_t size)
+{
+    // return the id of a string, adding it if it isn't in the pool yet
+    
+    if(!m_impl  ||  !size)
+        return 0;
+    
+    
+    uint32_t hash = hashText(text,size);
+    size_t mask = m_impl->slots.size() - 1;
+    size_t slot = hash & mask;
+    
+    while(m_impl->slots[slot])
+    {
+        const Entry& entry = m_impl->entries[m_impl->slots[slot]];
+        
+        if(entry.hash == hash  &&  entry.size == size  &&  memcmp(entry.data,text,size) == 0)
+            return m_impl->slots[slot];
+        
+        slot = (slot + 1) & mask;
+    }
+    
+    
+    // strings too big to share a block well get one of their own.  blocks
+    // start small and double, so a pool with a few strings stays small
+    char *data;
+    
+    if(size > blockSize / 4)
+    {
+        m_impl->blocks.emplace_back(new char[size]);
+        m_impl->blockBytes += size;
+        
+        data = m_impl->blocks.back().get();
+    }
+    else
+    {
+        if(size > m_impl->blockRemaining)
+        {
+            size_t bytes = std::min(blockSize,std::max(firstBlockSize,m_impl->blockBytes));
+            
+            m_impl->blocks.emplace_back(new char[bytes]);
+            m_impl->blockBytes += bytes;
+            
+            m_impl->blockData = m_impl->blocks.back().get();
+            m_impl->blockRemaining = bytes;
+        }
+        
+        data = m_impl->blockData;
+        
+        m_impl->blockData += size;
+        m_impl->blockRemaining -= size;
+    }
+    
+    memcpy(data,text,size);
+    
+    
+    Entry entry;
+    entry.data = data;
+    entry.size = (uint32_t) size;
+    entry.hash = hash;
+    
+    Id id = (Id) m_impl->entries.size();
+    
+    m_impl->entries.push_back(entry);
+    m_impl->slots[slot] = id;
+    
+    
+    // keep the table at most half full, so probes stay short
+    if(m_impl->entries.size() * 2 > m_impl->slots.size())
+    {
+        m_impl->slots.assign(m_impl->slots.size() * 2,0);
+        mask = m_impl->slots.size() - 1;
+        
+        for(Id index = 1;index < (Id) m_impl->entries.size();++index)
+        {
+            slot = m_impl->entries[index].hash & mask;
+            
+            while(m_impl->slots[slot])
+                slot = (slot + 1) & mask;
+            
+            m_impl->slots[slot] = index;
+        }
+    }
+    
+    return id;
+}
+
+
+StringPool::Id StringPool::intern(const std::string& text)
+{
+    return intern(text.data(),text.size());
+}
+
+
+const char *StringPool::data(Id id) const
+{
+    // the string isn't null terminated, so this goes with size()
+    
+    if(!m_impl  ||  id >= m_impl->entries.size())
+        return "";
+    
+    return m_impl->entries[id].data;
+}
+
+
+size_t StringPool::size(Id id) const
+{
+    if(!m_impl  ||  id >= m_impl->entries.size())
+        return 0;
+    
+    return m_impl->entries[id].size;
+}
+
+
+std::string StringPool::text(Id id) const
+{
+    return std::string(data(id),size(id));
+}
+
+
+size_t StringPool::count() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->entries.size();
+}
+
+
+size_t StringPool::memoryUsage() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return sizeof(PrivateImpl) + m_impl->blockBytes +
+           m_impl->blocks.capacity() * sizeof(std::unique_ptr<char[]>) +
+           m_impl->entries.capacity() * sizeof(Entry) +
+           m_impl->slots.capacity() * sizeof(Id);
+}
+
+
+void StringPool::write(std::string& out) const
+{
+    // append the pool to out:  the number of strings, the size of each, then
+    // their bytes.  the empty string at id 0 is implied
+    
+    if(!m_impl)
+        return;
+    
+    uint32_t count = (uint32_t) m_impl->entries.size();
+    writeValue(out,count);
+    
+    for(Id id = 1;id < count;++id)
+        writeValue(out,m_impl->entries[id].size);
+    
+    for(Id id = 1;id < count;++id)
+        writeBytes(out,m_impl->entries[id].data,m_impl->entries[id].size);
+}
+
+
+bool StringPool::read(const char *&data,const char *end)
+{
+    // replace the pool with one that write() appended, moving data past it.
+    // every string gets back the id it had.  this returns false, leaving the
+    // pool empty, if what's there isn't a pool
+    
+    if(!m_impl)
+        return false;
+    
+    clear();
+    
+    
+    uint32_t count;
+    const char *sizes;
+    
+    if(!readValue(data,end,count)  ||  !count  ||
+       !readBytes(data,end,(size_t) (count - 1) * sizeof(uint32_t),sizes))
+        return false;
+    
+    
+    // size the table for all of them up front, rather than growing it
+    size_t slots = m_impl->slots.size();
+    
+    while(slots < (size_t) count * 2)
+        slots *= 2;
+    
+    m_impl->slots.assign(slots,0);
+    m_impl->entries.reserve(count);
+    
+    for(Id id = 1;id < count;++id)
+    {
+        uint32_t size;
+        const char *bytes;
+        
+        memcpy(&size,sizes + (id - 1) * sizeof(uint32_t),sizeof(size));
+        
+        if(!size  ||  !readBytes(data,end,size,bytes)  ||  intern(bytes,size) != id)
+        {
+            clear();
+            return false;
+        }
+    }
+    
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+class StringPool
+{
+    public:
+        typedef uint32_t Id;
+        
+    public:
+        StringPool();
+        ~StringPool();
+        
+        void clear();
+        void swap(StringPool& other);
+        
+        Id intern(const char *text,size_t size);
+        Id intern(const std::string& text);
+        
+        const char *data(Id id) const;
+        size_t size(Id id) const;
+        std::string text(Id id) const;
+        
+        size_t count() const;
+        size_t memoryUsage() const;
+        
+        void write(std::string& out) const;
+        bool read(const char *&data,const char *end);
+        
+    private:
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
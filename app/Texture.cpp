@@ -1,43 +1,25 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include "glad/glad.h"
+#include "GraphicsCache.h"
 #include "Texture.h"
 
 
-static const char *vertexShaderSource =
-"#version 330 core\n"
-"layout (location = 0) in vec3 aPos;\n"
-"layout (location = 1) in vec2 aTexCoord;\n"
-"\n"
-"out vec2 texCoord;\n"
-"\n"
-"void main()\n"
-"{\n"
-"    gl_Position = vec4(aPos,1.0);\n"
-"    texCoord = aTexCoord;\n"
-"}\n\0";
-
-static const char *fragmentShaderSource =
-"#version 330 core\n"
-"in vec2 texCoord;\n"
-"\n"
-"out vec4 FragColor;\n"
-"\n"
-"uniform sampler2D ourTexture;\n"
-"\n"
-"void main()\n"
-"{\n"
-"    FragColor = texture(ourTexture,texCoord);\n"
-"}\n\0";
+// BC1 is the S3TC extension, which every desktop GPU has, but isn't core
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
 
 
 struct Texture::PrivateImpl
 {
     int width;
     int height;
-    unsigned int shaderProgram;
-    unsigned int vao;
-    unsigned int vbo;
-    unsigned int ebo;
+    size_t size;
+    int bitsPerPixel;
+    int levels;
+    Image::Compression compression;
     unsigned int texture;
 };
 
@@ -49,10 +31,10 @@ Texture::Texture() :
     {
         m_impl->width = 0;
         m_impl->height = 0;
-        m_impl->shaderProgram = 0;
-        m_impl->vao = 0;
-        m_impl->vbo = 0;
-        m_impl->ebo = 0;
+        m_impl->size = 0;
+        m_impl->bitsPerPixel = 0;
+        m_impl->levels = 0;
+        m_impl->compression = Image::CompressionNone;
         m_impl->texture = 0;
     }
 }
@@ -78,94 +60,13 @@ bool Texture::create(const Image& image)
     
     m_impl->width = image.width();
     m_impl->height = image.height();
+    m_impl->bitsPerPixel = image.bitsPerPixel();
+    m_impl->levels = image.levels();
+    m_impl->compression = image.compression();
     
     
-    // create and compile vertex shader
-    
-    unsigned int vertexShader = ::glCreateShader(GL_VERTEX_SHADER);
-    ::glShaderSource(vertexShader,1,&vertexShaderSource,nullptr);
-    ::glCompileShader(vertexShader);
-    
-    int success;
-    ::glGetShaderiv(vertexShader,GL_COMPILE_STATUS,&success);
-    
-    if(!success)
-    {
-        char infoLog[512];
-        ::glGetShaderInfoLog(vertexShader,512,nullptr,infoLog);
-        std::cout << "Texture::create:  error compiling vertex shader:  " << infoLog << std::endl;
-        return false;
-    }
-    
-    
-    // create and compile fragment shader
-    
-    unsigned int fragmentShader = ::glCreateShader(GL_FRAGMENT_SHADER);
-    ::glShaderSource(fragmentShader,1,&fragmentShaderSource,nullptr);
-    ::glCompileShader(fragmentShader);
-    
-    ::glGetShaderiv(fragmentShader,GL_COMPILE_STATUS,&success);
-    
-    if(!success)
-    {
-        char infoLog[512];
-        ::glGetShaderInfoLog(fragmentShader,512,nullptr,infoLog);
-        std::cout << "Texture::create:  error compiling fragment shader:  " << infoLog << std::endl;
-        return false;
-    }
-    
-    
-    // create and link shader program
-    
-    m_impl->shaderProgram = ::glCreateProgram();
-    ::glAttachShader(m_impl->shaderProgram,vertexShader);
-    ::glAttachShader(m_impl->shaderProgram,fragmentShader);
-    ::glLinkProgram(m_impl->shaderProgram);
-    
-    ::glGetProgramiv(m_impl->shaderProgram,GL_LINK_STATUS,&success);
-    
-    if(!success)
-    {
-        char infoLog[512];
-        ::glGetProgramInfoLog(m_impl->shaderProgram,512,nullptr,infoLog);
-        std::cout << "Texture::create:  error linking shader program:  " << infoLog << std::endl;
-        return false;
-    }
-    
-
-    ::glDeleteShader(vertexShader);
-    ::glDeleteShader(fragmentShader);
-
-
-
-
-    float vertices[] =
-    {
-        // positions         // texture coords
-         1.0f,  1.0f, 0.0f,  1.0f, 1.0f,
-         1.0f, -1.0f, 0.0f,  1.0f, 0.0f,
-        -1.0f, -1.0f, 0.0f,  0.0f, 0.0f,
-        -1.0f,  1.0f, 0.0f,  0.0f, 1.0f
-    };
-    
-    unsigned int indices[] =
-    {
-        0, 1, 3,
-        1, 2, 3
-    };
-    
-
-    ::glGenVertexArrays(1,&m_impl->vao);
-    ::glBindVertexArray(m_impl->vao);
-    
-    ::glGenBuffers(1,&m_impl->vbo);
-    ::glBindBuffer(GL_ARRAY_BUFFER,m_impl->vbo);
-    ::glBufferData(GL_ARRAY_BUFFER,sizeof(vertices),vertices,GL_STATIC_DRAW);
-
-    ::glGenBuffers(1,&m_impl->ebo);
-    ::glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,m_impl->ebo);
-    ::glBufferData(GL_ELEMENT_ARRAY_BUFFER,sizeof(indices),indices,GL_STATIC_DRAW);
-    
+    // the shaders and the quad are shared by every texture, so this is just
+    // the pixels
     ::glGenTextures(1,&m_impl->texture);
     ::glBindTexture(GL_TEXTURE_2D,m_impl->texture);
     ::glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
@@ -173,43 +74,100 @@ bool Texture::create(const Image& image)
     ::glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR_MIPMAP_LINEAR);
     ::glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
 
-    switch(image.bitsPerPixel())
+    if(image.compression() != Image::CompressionNone)
     {
-        case 8:
-            ::glPixelStorei(GL_UNPACK_ALIGNMENT,1);
-            ::glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,image.width(),image.height(),
-                                         0,GL_RED,GL_UNSIGNED_BYTE,image.pixelData());
-            break;
+        // block compressed pixels go up as they are, and the GPU can't make
+        // mip levels of them, so they have to come with the image
+        GLenum internalFormat = image.compression() == Image::CompressionBc1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
         
-        case 24:
-            ::glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,image.width(),image.height(),
-                                         0,GL_RGB,GL_UNSIGNED_BYTE,image.pixelData());
-            break;
+        for(int level = 0;level < image.levels();++level)
+        {
+            const char *data = (const char *) image.pixelData(level);
+            const char *end = level + 1 < image.levels() ? (const char *) image.pixelData(level + 1) : (const char *) image.pixelData() + image.size();
+            
+            ::glCompressedTexImage2D(GL_TEXTURE_2D,level,internalFormat,std::max(1,image.width() >> level),std::max(1,image.height() >> level),
+                                                   0,(GLsizei) (end - data),data);
+        }
         
-        case 32:
-            ::glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,image.width(),image.height(),
-                                         0,GL_RGBA,GL_UNSIGNED_BYTE,image.pixelData());
-            break;
+        ::glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,image.levels() - 1);
         
-        default:
-            std::cerr << "Texture::create:  unsupported bit depth '" << image.bitsPerPixel() << "'" << std::endl;
-            return false;
+        m_impl->size = image.size();
+    }
+    else
+    {
+        GLenum format;
+        
+        switch(image.bitsPerPixel())
+        {
+            case 8:
+                ::glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+                format = GL_RED;
+                break;
+            
+            case 24:
+                ::glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+                format = GL_RGB;
+                break;
+            
+            case 32:
+                format = GL_RGBA;
+                break;
+            
+            default:
+                std::cerr << "Texture::create:  unsupported bit depth '" << image.bitsPerPixel() << "'" << std::endl;
+                return false;
+        }
+        
+        // an image that comes with its mip levels, such as one from the
+        // texture cache, has them all uploaded.  otherwise the GPU makes them
+        for(int level = 0;level < image.levels();++level)
+        {
+            ::glTexImage2D(GL_TEXTURE_2D,level,GL_RGBA,std::max(1,image.width() >> level),std::max(1,image.height() >> level),
+                                         0,format,GL_UNSIGNED_BYTE,image.pixelData(level));
+        }
+        
+        if(image.levels() > 1)
+            ::glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,image.levels() - 1);
+        else
+            ::glGenerateMipmap(GL_TEXTURE_2D);
+        
+        // RGBA, and a third again for the mip levels
+        m_impl->size = (size_t) image.width() * image.height() * 4 * 4 / 3;
     }
-                                 
-    ::glGenerateMipmap(GL_TEXTURE_2D);
     
     ::glEnable(GL_BLEND);
     ::glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
     
-    // position attribute
-    ::glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,5 * sizeof(float),(void *) 0);
-    ::glEnableVertexAttribArray(0);
-    
-    // texture coord attribute
-    ::glVertexAttribPointer(1,2,GL_FLOAT,GL_FALSE,5 * sizeof(float),(void *)(3 * sizeof(float)));
-    ::glEnableVertexAttribArray(1);
+    return true;
+}
 
 
+bool Texture::update(const Image& image)
+{
+    // replace the pixels of a texture with an image the same size and kind,
+    // such as the next frame of a video, without making a new texture.
+    // anything else makes one
+    
+    if(!valid()  ||  image.width() != m_impl->width  ||  image.height() != m_impl->height  ||
+       image.bitsPerPixel() != m_impl->bitsPerPixel  ||  image.levels() != 1  ||  m_impl->levels != 1  ||
+       image.compression() != Image::CompressionNone  ||  m_impl->compression != Image::CompressionNone)
+        return create(image);
+    
+    
+    GLenum format;
+    
+    switch(image.bitsPerPixel())
+    {
+        case 8:     format = GL_RED;   break;
+        case 24:    format = GL_RGB;   break;
+        default:    format = GL_RGBA;  break;
+    }
+    
+    ::glBindTexture(GL_TEXTURE_2D,m_impl->texture);
+    ::glPixelStorei(GL_UNPACK_ALIGNMENT,image.bitsPerPixel() == 32 ? 4 : 1);
+    ::glTexSubImage2D(GL_TEXTURE_2D,0,0,0,image.width(),image.height(),format,GL_UNSIGNED_BYTE,image.pixelData());
+    ::glGenerateMipmap(GL_TEXTURE_2D);
+    
     return true;
 }
 
@@ -222,36 +180,16 @@ void Texture::destroy()
     
     m_impl->width = 0;
     m_impl->height = 0;
-    
-    if(m_impl->vao)
-    {
-        ::glDeleteVertexArrays(1,&m_impl->vao);
-        m_impl->vao = 0;
-    }
-    
-    if(m_impl->vbo)
-    {
-        ::glDeleteBuffers(1,&m_impl->vbo);
-        m_impl->vbo = 0;
-    }
-    
-    if(m_impl->ebo)
-    {
-        ::glDeleteBuffers(1,&m_impl->ebo);
-        m_impl->ebo = 0;
-    }
+    m_impl->size = 0;
+    m_impl->bitsPerPixel = 0;
+    m_impl->levels = 0;
+    m_impl->compression = Image::CompressionNone;
     
     if(m_impl->texture)
     {
         ::glDeleteTextures(1,&m_impl->texture);
         m_impl->texture = 0;
     }
-    
-    if(m_impl->shaderProgram)
-    {
-        ::glDeleteProgram(m_impl->shaderProgram);
-        m_impl->shaderProgram = 0;
-    }
 }
 
 
@@ -260,7 +198,7 @@ bool Texture::valid() const
     if(!m_impl)
         return false;
     
-    return m_impl->shaderProgram  &&  m_impl->vao  &&  m_impl->vbo  &&  m_impl->ebo  &&  m_impl->texture;
+    return m_impl->texture != 0;
 }
 
 
@@ -282,17 +220,32 @@ int Texture::height() const
 }
 
 
+size_t Texture::size() const
+{
+    // about how much memory the texture takes on the GPU
+    
+    if(!valid())
+        return 0;
+    
+    return m_impl->size;
+}
+
+
 void Texture::draw(float screenX,float screenY,float screenWidth,float screenHeight,
                    float textureX,float textureY,float textureWidth,float textureHeight)
 {
     if(!valid())
         return;
     
+    GraphicsCache *cache = GraphicsCache::current();
+    unsigned int program = cache ? cache->program(GraphicsCache::ProgramTexture) : 0;
+    
+    if(!program  ||  !cache->bind(GraphicsCache::GeometryQuad))
+        return;
     
-    ::glBindTexture(GL_TEXTURE_2D,m_impl->texture);
     
-    ::glUseProgram(m_impl->shaderProgram);
-    ::glBindVertexArray(m_impl->vao);
+    ::glBindTexture(GL_TEXTURE_2D,m_impl->texture);
+    ::glUseProgram(program);
 
 
     float vertices[] =
@@ -304,10 +257,46 @@ void Texture::draw(float screenX,float screenY,float screenWidth,float screenHei
         screenX - screenWidth * 0.5f, screenY + screenHeight * 0.5f, 0.0f,  textureX, textureY + textureHeight
     };
     
-    ::glBindBuffer(GL_ARRAY_BUFFER,m_impl->vbo);
-    ::glBufferData(GL_ARRAY_BUFFER,sizeof(vertices),vertices,GL_STATIC_DRAW);
+    ::glBufferSubData(GL_ARRAY_BUFFER,0,sizeof(vertices),vertices);
 
 
     ::glDrawElements(GL_TRIANGLES,6,GL_UNSIGNED_INT,0);
     ::glBindVertexArray(0);
 }
+
+
+bool Texture::supports(Image::Compression compression)
+{
+    // whether the current context takes textures compressed this way.  BC7
+    // is core from OpenGL 4.2, and we ask for 4.3
+    
+    const char *extension = nullptr;
+    
+    switch(compression)
+    {
+        case Image::CompressionNone:
+        case Image::CompressionBc7:
+            return true;
+        
+        case Image::CompressionBc1:
+            extension = "GL_EXT_texture_compression_s3tc";
+            break;
+        
+        case Image::CompressionCount:
+            return false;
+    }
+    
+    
+    GLint count = 0;
+    ::glGetIntegerv(GL_NUM_EXTENSIONS,&count);
+    
+    for(GLint index = 0;index < count;++index)
+    {
+        const char *name = (const char *) ::glGetStringi(GL_EXTENSIONS,index);
+        
+        if(name  &&  strcmp(name,extension) == 0)
+            return true;
+    }
+    
+    return false;
+}
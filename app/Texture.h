@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include "Image.h"
 
 
@@ -9,16 +10,20 @@ class Texture
         ~Texture();
         
         bool create(const Image& image);
+        bool update(const Image& image);
         void destroy();
         
         bool valid() const;
         
         int width() const;
         int height() const;
+        size_t size() const;
         
         void draw(float screenX,float screenY,float screenWidth,float screenHeight,
                   float textureX,float textureY,float textureWidth,float textureHeight);
         
+        static bool supports(Image::Compression compression);
+        
     private:
         struct PrivateImpl;
         PrivateImpl *m_impl;
@@ -0,0 +1,245 @@
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include "CacheFiles.h"
+#include "MappedFile.h"
+#include "Serialization.h"
+#include "TextureCache.h"
+
+
+// tile art decoded once is kept on disk the way it goes to the GPU, scaled,
+// bottom row first, and with every mip level, so the next start maps the
+// file and hands the pixels straight to the texture without decoding.  an
+// entry is named after the URL, the width it was decoded at, the compression
+// it was asked for and a hash of the encoded image, so new art under the same
+// URL makes a new entry rather than showing the old one.  art with alpha can
+// end up compressed another way than it was asked for, so the header has the
+// compression it actually got.  the file is a header followed by the pixels:
+//
+//     header   "DPTC", version, byte order, key, width, height, bits per
+//              pixel, levels, compression, pixel size, padded to 16 bytes
+//     pixels   each level after the one before, largest first
+//
+// there's no checksum over the pixels, which would cost about what decoding
+// does.  an entry that doesn't match, or is cut short, is decoded again
+
+
+static const char magic[4] = { 'D','P','T','C' };
+static const uint32_t version = 2;
+static const uint32_t byteOrder = 0x01020304;
+
+
+static std::string keyText(const std::string& url,int width,Image::Compression compression,uint64_t contentHash)
+{
+    char suffix[48];
+    std::snprintf(suffix,sizeof(suffix),"#%d#%s#%016llx",width,Image::name(compression),(unsigned long long) contentHash);
+    
+    return url + suffix;
+}
+
+
+struct TextureCache::PrivateImpl
+{
+    std::string directory;
+    
+    std::atomic<int> hits;
+    std::atomic<int> misses;
+};
+
+
+TextureCache::TextureCache() :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+    {
+        m_impl->hits = 0;
+        m_impl->misses = 0;
+    }
+}
+
+
+TextureCache::~TextureCache()
+{
+    if(m_impl)
+    {
+        close();
+        delete m_impl;
+    }
+}
+
+
+bool TextureCache::valid() const
+{
+    if(!m_impl)
+        return false;
+    
+    return !m_impl->directory.empty();
+}
+
+
+bool TextureCache::open(const std::string& directory)
+{
+    if(!m_impl)
+        return false;
+    
+    close();
+    
+    
+    if(!makeDirectory(directory))
+    {
+        std::cerr << "TextureCache::open:  error opening cache directory '" << directory << "'" << std::endl;
+        return false;
+    }
+    
+    m_impl->directory = directory;
+    
+    return true;
+}
+
+
+void TextureCache::close()
+{
+    if(!m_impl)
+        return;
+    
+    
+    m_impl->directory.clear();
+}
+
+
+bool TextureCache::load(const std::string& url,int width,Image::Compression compression,uint64_t contentHash,Image& image)
+{
+    // map the entry for an image and point the image at its pixels.  the file
+    // stays mapped until the image lets go of them.  a missing entry isn't an
+    // error, just a miss
+    
+    if(!valid())
+        return false;
+    
+    
+    std::string key = keyText(url,width,compression,contentHash);
+    std::string filename = m_impl->directory + "/" + hashName(key) + ".tex";
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    
+    if(!file->open(filename))
+    {
+        ++m_impl->misses;
+        return false;
+    }
+    
+    const char *start = file->data();
+    const char *data = start;
+    const char *end = data + file->size();
+    
+    
+    char fileMagic[sizeof(magic)];
+    uint32_t fileVersion;
+    uint32_t fileByteOrder;
+    uint32_t keySize;
+    const char *fileKey;
+    int32_t imageWidth;
+    int32_t imageHeight;
+    int32_t bitsPerPixel;
+    int32_t levels;
+    int32_t fileCompression;
+    uint64_t pixelSize;
+    
+    bool ok = readValue(data,end,fileMagic)  &&  readValue(data,end,fileVersion)  &&
+              readValue(data,end,fileByteOrder)  &&  readValue(data,end,keySize)  &&
+              readBytes(data,end,keySize,fileKey)  &&  readValue(data,end,imageWidth)  &&
+              readValue(data,end,imageHeight)  &&  readValue(data,end,bitsPerPixel)  &&
+              readValue(data,end,levels)  &&  readValue(data,end,fileCompression)  &&
+              readValue(data,end,pixelSize);
+    
+    ok = ok  &&  memcmp(fileMagic,magic,sizeof(magic)) == 0  &&  fileVersion == version  &&  fileByteOrder == byteOrder  &&
+         key.compare(0,std::string::npos,fileKey,keySize) == 0;
+    
+    // two keys can hash to the same name, so the key in the file has to match
+    // too.  anything else is some other image, or an older version
+    if(!ok)
+    {
+        ++m_impl->misses;
+        return false;
+    }
+    
+    
+    data = start + ((data - start + 15) & ~(ptrdiff_t) 15);
+    
+    if(imageWidth <= 0  ||  imageHeight <= 0  ||  (bitsPerPixel != 4  &&  bitsPerPixel != 8  &&  bitsPerPixel != 24  &&  bitsPerPixel != 32)  ||
+       fileCompression < 0  ||  fileCompression >= Image::CompressionCount  ||  levels < 1  ||  levels > 32  ||
+       pixelSize != Image::size(imageWidth,imageHeight,bitsPerPixel,levels,(Image::Compression) fileCompression)  ||
+       data > end  ||  pixelSize != (uint64_t) (end - data))
+    {
+        std::cerr << "TextureCache::load:  error reading '" << filename << "':  damaged" << std::endl;
+        
+        ++m_impl->misses;
+        return false;
+    }
+    
+    
+    // the image only ever reads its pixels, so it's safe to hand it the
+    // read-only mapping
+    image.adopt((unsigned char *) data,imageWidth,imageHeight,bitsPerPixel,[file](void *) {},levels,(Image::Compression) fileCompression);
+    
+    ++m_impl->hits;
+    return true;
+}
+
+
+bool TextureCache::store(const std::string& url,int width,Image::Compression compression,uint64_t contentHash,const Image& image)
+{
+    // write an image's pixels, every level of them, after a header that says
+    // what they are
+    
+    if(!valid()  ||  !image.valid())
+        return false;
+    
+    
+    std::string key = keyText(url,width,compression,contentHash);
+    std::string filename = m_impl->directory + "/" + hashName(key) + ".tex";
+    
+    std::string header;
+    
+    writeBytes(header,magic,sizeof(magic));
+    writeValue(header,version);
+    writeValue(header,byteOrder);
+    writeValue(header,(uint32_t) key.size());
+    writeBytes(header,key.data(),key.size());
+    writeValue(header,(int32_t) image.width());
+    writeValue(header,(int32_t) image.height());
+    writeValue(header,(int32_t) image.bitsPerPixel());
+    writeValue(header,(int32_t) image.levels());
+    writeValue(header,(int32_t) image.compression());
+    writeValue(header,(uint64_t) image.size());
+    
+    header.resize((header.size() + 15) & ~(size_t) 15,'\0');
+    
+    
+    if(!replaceFile(filename,header,(const char *) image.pixelData(),image.size()))
+    {
+        std::cerr << "TextureCache::store:  error writing '" << filename << "'" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+
+int TextureCache::hits() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->hits;
+}
+
+
+int TextureCache::misses() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->misses;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "Image.h"
+
+
+class TextureCache
+{
+    public:
+        TextureCache();
+        ~TextureCache();
+        
+        bool valid() const;
+        
+        bool open(const std::string& directory);
+        void close();
+        
+        bool load(const std::string& url,int width,Image::Compression compression,uint64_t contentHash,Image& image);
+        bool store(const std::string& url,int width,Image::Compression compression,uint64_t contentHash,const Image& image);
+        
+        int hits() const;
+        int misses() const;
+        
+    private:
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
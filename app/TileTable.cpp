@@ -0,0 +1,525 @@
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include "Serialization.h"
+#include "StringPool.h"
+#include "TileTable.h"
+
+
+// the tiles are stored column by column rather than as an array of structs,
+// so a pass over one field, like the render loop's over textures, only
+// touches that field.  every string goes through one pool, so the ratings
+// and release dates that thousands of tiles share are each kept once
+//
+// urls are split around the path segment with the most digits in it, which is
+// usually a hash or an id.  what comes before and after it is the same for
+// most of the urls from one service, so those parts are only kept once.  each
+// distinct url then gets its own id, which is what images are looked up by
+
+
+struct UrlParts
+{
+    StringPool::Id head;
+    StringPool::Id body;
+    StringPool::Id tail;
+};
+
+
+static uint32_t hashParts(const UrlParts& parts)
+{
+    return (parts.head * 2654435761u) ^ (parts.body * 2246822519u) ^ (parts.tail * 3266489917u);
+}
+
+
+static void indexUrls(const std::vector<UrlParts>& urlParts,std::vector<UrlId>& urlSlots,size_t slotCount)
+{
+    // rebuild the url slots at a new size, which has to be a power of 2
+    
+    urlSlots.assign(slotCount,0);
+    size_t mask = slotCount - 1;
+    
+    for(UrlId url = 1;url < (UrlId) urlParts.size();++url)
+    {
+        size_t slot = hashParts(urlParts[url]) & mask;
+        
+        while(urlSlots[slot])
+            slot = (slot + 1) & mask;
+        
+        urlSlots[slot] = url;
+    }
+}
+
+
+static void splitUrl(const std::string& url,size_t& bodyStart,size_t& bodyEnd)
+{
+    // find the path segment with the most digits, taking the longer one when
+    // two have as many.  the scheme, host and query are left out of it
+    
+    size_t pathEnd = url.find('?');
+    
+    if(pathEnd == std::string::npos)
+        pathEnd = url.size();
+    
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    start = url.find('/',start);
+    
+    bodyStart = pathEnd;
+    bodyEnd = pathEnd;
+    
+    size_t bodyDigits = 0;
+    
+    while(start != std::string::npos  &&  start < pathEnd)
+    {
+        size_t end = start + 1;
+        size_t digits = 0;
+        
+        while(end < pathEnd  &&  url[end] != '/')
+        {
+            if(url[end] >= '0'  &&  url[end] <= '9')
+                ++digits;
+            
+            ++end;
+        }
+        
+        if(digits > bodyDigits  ||  (digits == bodyDigits  &&  digits  &&  end - (start + 1) > bodyEnd - bodyStart))
+        {
+            bodyStart = start + 1;
+            bodyEnd = end;
+            bodyDigits = digits;
+        }
+        
+        start = end < pathEnd ? end : std::string::npos;
+    }
+}
+
+
+struct TileTable::PrivateImpl
+{
+    StringPool strings;
+    
+    // indexed by TileId
+    std::vector<StringPool::Id> names;
+    std::vector<StringPool::Id> releaseDates;
+    std::vector<StringPool::Id> ratings;
+    std::vector<UrlId> urls;
+    std::vector<UrlId> videoUrls;
+    std::vector<std::shared_ptr<Texture>> textures;
+    std::vector<int> textureWidths;
+    
+    // indexed by UrlId, and found again through an open addressed table of
+    // slots, like the string pool's.  the empty url is never looked up
+    std::vector<UrlParts> urlParts;
+    std::vector<UrlId> urlSlots;
+};
+
+
+TileTable::TileTable() :
+    m_impl(new PrivateImpl)
+{
+    clear();
+}
+
+
+TileTable::~TileTable()
+{
+    if(m_impl)
+        delete m_impl;
+}
+
+
+void TileTable::clear()
+{
+    // forget every tile.  ids handed out before this are no longer valid
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->strings.clear();
+    
+    m_impl->names.clear();
+    m_impl->releaseDates.clear();
+    m_impl->ratings.clear();
+    m_impl->urls.clear();
+    m_impl->videoUrls.clear();
+    m_impl->textures.clear();
+    m_impl->textureWidths.clear();
+    
+    
+    // url 0 is the empty url
+    UrlParts empty;
+    empty.head = 0;
+    empty.body = 0;
+    empty.tail = 0;
+    
+    m_impl->urlParts.assign(1,empty);
+    m_impl->urlSlots.assign(256,0);
+}
+
+
+void TileTable::swap(TileTable& other)
+{
+    std::swap(m_impl,other.m_impl);
+}
+
+
+TileId TileTable::add(const Tile& tile)
+{
+    // add a tile and return its id.  ids count up from 0 and are never
+    // reused, so they stay valid however the rows holding them change
+    
+    if(!m_impl)
+        return 0;
+    
+    m_impl->names.push_back(m_impl->strings.intern(tile.name));
+    m_impl->releaseDates.push_back(m_impl->strings.intern(tile.releaseDate));
+    m_impl->ratings.push_back(m_impl->strings.intern(tile.rating));
+    m_impl->urls.push_back(internUrl(tile.url));
+    m_impl->videoUrls.push_back(internUrl(tile.videoUrl));
+    m_impl->textures.push_back(std::shared_ptr<Texture>());
+    m_impl->textureWidths.push_back(0);
+    
+    return (TileId) m_impl->names.size() - 1;
+}
+
+
+TileId TileTable::add(const TileTable& other,TileId id)
+{
+    // copy a tile over from another table, like the one a parser filled in,
+    // and return its id in this one
+    
+    if(!m_impl  ||  !other.m_impl  ||  id >= other.size())
+        return 0;
+    
+    
+    const StringPool& strings = other.m_impl->strings;
+    
+    StringPool::Id name = other.m_impl->names[id];
+    StringPool::Id releaseDate = other.m_impl->releaseDates[id];
+    StringPool::Id rating = other.m_impl->ratings[id];
+    
+    m_impl->names.push_back(m_impl->strings.intern(strings.data(name),strings.size(name)));
+    m_impl->releaseDates.push_back(m_impl->strings.intern(strings.data(releaseDate),strings.size(releaseDate)));
+    m_impl->ratings.push_back(m_impl->strings.intern(strings.data(rating),strings.size(rating)));
+    
+    m_impl->urls.push_back(internUrl(other,other.m_impl->urls[id]));
+    m_impl->videoUrls.push_back(internUrl(other,other.m_impl->videoUrls[id]));
+    
+    m_impl->textures.push_back(other.m_impl->textures[id]);
+    m_impl->textureWidths.push_back(other.m_impl->textureWidths[id]);
+    
+    return (TileId) m_impl->names.size() - 1;
+}
+
+
+size_t TileTable::size() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->names.size();
+}
+
+
+std::string TileTable::name(TileId id) const
+{
+    if(!m_impl  ||  id >= m_impl->names.size())
+        return std::string();
+    
+    return m_impl->strings.text(m_impl->names[id]);
+}
+
+
+std::string TileTable::releaseDate(TileId id) const
+{
+    if(!m_impl  ||  id >= m_impl->releaseDates.size())
+        return std::string();
+    
+    return m_impl->strings.text(m_impl->releaseDates[id]);
+}
+
+
+std::string TileTable::rating(TileId id) const
+{
+    if(!m_impl  ||  id >= m_impl->ratings.size())
+        return std::string();
+    
+    return m_impl->strings.text(m_impl->ratings[id]);
+}
+
+
+UrlId TileTable::url(TileId id) const
+{
+    // the id of the tile's image url.  two tiles with the same url get the
+    // same id
+    
+    if(!m_impl  ||  id >= m_impl->urls.size())
+        return 0;
+    
+    return m_impl->urls[id];
+}
+
+
+UrlId TileTable::videoUrl(TileId id) const
+{
+    // the id of the tile's video url, which is 0 if it has none
+    
+    if(!m_impl  ||  id >= m_impl->videoUrls.size())
+        return 0;
+    
+    return m_impl->videoUrls[id];
+}
+
+
+std::string TileTable::urlText(UrlId url) const
+{
+    if(!m_impl  ||  url >= m_impl->urlParts.size())
+        return std::string();
+    
+    const UrlParts& parts = m_impl->urlParts[url];
+    
+    std::string text;
+    text.reserve(m_impl->strings.size(parts.head) + m_impl->strings.size(parts.body) + m_impl->strings.size(parts.tail));
+    text.append(m_impl->strings.data(parts.head),m_impl->strings.size(parts.head));
+    text.append(m_impl->strings.data(parts.body),m_impl->strings.size(parts.body));
+    text.append(m_impl->strings.data(parts.tail),m_impl->strings.size(parts.tail));
+    
+    return text;
+}
+
+
+size_t TileTable::urlCount() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->urlParts.size();
+}
+
+
+const std::shared_ptr<Texture>& TileTable::texture(TileId id) const
+{
+    static const std::shared_ptr<Texture> none;
+    
+    if(!m_impl  ||  id >= m_impl->textures.size())
+        return none;
+    
+    return m_impl->textures[id];
+}
+
+
+int TileTable::textureWidth(TileId id) const
+{
+    if(!m_impl  ||  id >= m_impl->textureWidths.size())
+        return 0;
+    
+    return m_impl->textureWidths[id];
+}
+
+
+void TileTable::setTexture(TileId id,std::shared_ptr<Texture> texture,int width)
+{
+    // keep the texture made from the tile's image, and the width of the image
+    // it was made from.  a null texture drops it
+    
+    if(!m_impl  ||  id >= m_impl->textures.size())
+        return;
+    
+    m_impl->textures[id] = std::move(texture);
+    m_impl->textureWidths[id] = m_impl->textures[id] ? width : 0;
+}
+
+
+size_t TileTable::memoryUsage() const
+{
+    // how much memory the table holds, not counting the textures themselves
+    
+    if(!m_impl)
+        return 0;
+    
+    return sizeof(PrivateImpl) + m_impl->strings.memoryUsage() +
+           m_impl->names.capacity() * sizeof(StringPool::Id) +
+           m_impl->releaseDates.capacity() * sizeof(StringPool::Id) +
+           m_impl->ratings.capacity() * sizeof(StringPool::Id) +
+           m_impl->urls.capacity() * sizeof(UrlId) +
+           m_impl->videoUrls.capacity() * sizeof(UrlId) +
+           m_impl->textures.capacity() * sizeof(std::shared_ptr<Texture>) +
+           m_impl->textureWidths.capacity() * sizeof(int) +
+           m_impl->urlParts.capacity() * sizeof(UrlParts) +
+           m_impl->urlSlots.capacity() * sizeof(UrlId);
+}
+
+
+void TileTable::write(std::string& out) const
+{
+    // append the table to out:  its strings, its urls, then each column of
+    // tiles.  the textures are left behind
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->strings.write(out);
+    
+    uint32_t urlCount = (uint32_t) m_impl->urlParts.size();
+    writeValue(out,urlCount);
+    writeBytes(out,(const char *) (m_impl->urlParts.data() + 1),(urlCount - 1) * sizeof(UrlParts));
+    
+    uint32_t tileCount = (uint32_t) m_impl->names.size();
+    writeValue(out,tileCount);
+    
+    for(const std::vector<uint32_t> *column : { &m_impl->names,&m_impl->releaseDates,&m_impl->ratings,&m_impl->urls,&m_impl->videoUrls })
+        writeBytes(out,(const char *) column->data(),tileCount * sizeof(uint32_t));
+}
+
+
+bool TileTable::read(const char *&data,const char *end)
+{
+    // replace the table with one that write() appended, moving data past it.
+    // tiles and urls get back the ids they had.  this returns false, leaving
+    // the table empty, if what's there isn't a table
+    
+    if(!m_impl)
+        return false;
+    
+    clear();
+    
+    if(!m_impl->strings.read(data,end))
+        return false;
+    
+    uint32_t stringCount = (uint32_t) m_impl->strings.count();
+    
+    
+    uint32_t urlCount;
+    const char *bytes;
+    
+    if(!readValue(data,end,urlCount)  ||  !urlCount  ||
+       !readBytes(data,end,(size_t) (urlCount - 1) * sizeof(UrlParts),bytes))
+    {
+        clear();
+        return false;
+    }
+    
+    m_impl->urlParts.resize(urlCount);
+    memcpy(m_impl->urlParts.data() + 1,bytes,(size_t) (urlCount - 1) * sizeof(UrlParts));
+    
+    for(UrlId url = 1;url < urlCount;++url)
+    {
+        const UrlParts& parts = m_impl->urlParts[url];
+        
+        if(parts.head >= stringCount  ||  parts.body >= stringCount  ||  parts.tail >= stringCount)
+        {
+            clear();
+            return false;
+        }
+    }
+    
+    size_t slotCount = m_impl->urlSlots.size();
+    
+    while(slotCount < (size_t) urlCount * 2)
+        slotCount *= 2;
+    
+    indexUrls(m_impl->urlParts,m_impl->urlSlots,slotCount);
+    
+    
+    uint32_t tileCount;
+    
+    if(!readValue(data,end,tileCount))
+    {
+        clear();
+        return false;
+    }
+    
+    for(std::vector<uint32_t> *column : { &m_impl->names,&m_impl->releaseDates,&m_impl->ratings,&m_impl->urls,&m_impl->videoUrls })
+    {
+        uint32_t limit = column == &m_impl->urls  ||  column == &m_impl->videoUrls ? urlCount : stringCount;
+        
+        if(!readBytes(data,end,(size_t) tileCount * sizeof(uint32_t),bytes))
+        {
+            clear();
+            return false;
+        }
+        
+        column->resize(tileCount);
+        memcpy(column->data(),bytes,(size_t) tileCount * sizeof(uint32_t));
+        
+        for(uint32_t value : *column)
+        {
+            if(value >= limit)
+            {
+                clear();
+                return false;
+            }
+        }
+    }
+    
+    m_impl->textures.resize(tileCount);
+    m_impl->textureWidths.resize(tileCount,0);
+    
+    return true;
+}
+
+
+UrlId TileTable::internUrl(const std::string& url)
+{
+    size_t bodyStart;
+    size_t bodyEnd;
+    
+    splitUrl(url,bodyStart,bodyEnd);
+    
+    return internUrl(url.data(),bodyStart,
+                     url.data() + bodyStart,bodyEnd - bodyStart,
+                     url.data() + bodyEnd,url.size() - bodyEnd);
+}
+
+
+UrlId TileTable::internUrl(const char *head,size_t headSize,const char *body,size_t bodySize,const char *tail,size_t tailSize)
+{
+    // return the id of a url from its parts, adding it if it's new
+    
+    UrlParts parts;
+    parts.head = m_impl->strings.intern(head,headSize);
+    parts.body = m_impl->strings.intern(body,bodySize);
+    parts.tail = m_impl->strings.intern(tail,tailSize);
+    
+    if(!parts.head  &&  !parts.body  &&  !parts.tail)
+        return 0;
+    
+    
+    size_t mask = m_impl->urlSlots.size() - 1;
+    size_t slot = hashParts(parts) & mask;
+    
+    while(m_impl->urlSlots[slot])
+    {
+        const UrlParts& entry = m_impl->urlParts[m_impl->urlSlots[slot]];
+        
+        if(entry.head == parts.head  &&  entry.body == parts.body  &&  entry.tail == parts.tail)
+            return m_impl->urlSlots[slot];
+        
+        slot = (slot + 1) & mask;
+    }
+    
+    
+    UrlId url = (UrlId) m_impl->urlParts.size();
+    
+    m_impl->urlParts.push_back(parts);
+    m_impl->urlSlots[slot] = url;
+    
+    if(m_impl->urlParts.size() * 2 > m_impl->urlSlots.size())
+        indexUrls(m_impl->urlParts,m_impl->urlSlots,m_impl->urlSlots.size() * 2);
+    
+    return url;
+}
+
+
+UrlId TileTable::internUrl(const TileTable& other,UrlId url)
+{
+    // return the id in this table of a url from another one
+    
+    const StringPool& strings = other.m_impl->strings;
+    const UrlParts& parts = other.m_impl->urlParts[url];
+    
+    return internUrl(strings.data(parts.head),strings.size(parts.head),
+                     strings.data(parts.body),strings.size(parts.body),
+                     strings.data(parts.tail),strings.size(parts.tail));
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include "Catalog.h"
+
+
+class Texture;
+
+class TileTable
+{
+    public:
+        TileTable();
+        ~TileTable();
+        
+        void clear();
+        void swap(TileTable& other);
+        
+        TileId add(const Tile& tile);
+        TileId add(const TileTable& other,TileId id);
+        
+        size_t size() const;
+        
+        std::string name(TileId id) const;
+        std::string releaseDate(TileId id) const;
+        std::string rating(TileId id) const;
+        
+        UrlId url(TileId id) const;
+        UrlId videoUrl(TileId id) const;
+        std::string urlText(UrlId url) const;
+        size_t urlCount() const;
+        
+        const std::shared_ptr<Texture>& texture(TileId id) const;
+        int textureWidth(TileId id) const;
+        void setTexture(TileId id,std::shared_ptr<Texture> texture,int width);
+        
+        size_t memoryUsage() const;
+        
+        void write(std::string& out) const;
+        bool read(const char *&data,const char *end);
+        
+    private:
+        UrlId internUrl(const std::string& url);
+        UrlId internUrl(const TileTable& other,UrlId url);
+        UrlId internUrl(const char *head,size_t headSize,const char *body,size_t bodySize,const char *tail,size_t tailSize);
+        
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -0,0 +1,83 @@
+#include <iostream>
+#include "Image.h"
+#include "TurboJpegImageDecoder.h"
+#include "turbojpeg.h"
+
+
+// libjpeg-turbo decodes JPEG with SIMD throughout, and can scale by any of
+// its supported factors inside the inverse DCT, so the pixels it writes are
+// already close to the size we draw them at.  it writes them bottom row
+// first itself
+
+
+bool TurboJpegImageDecoder::decode(const unsigned char *data,int length,int width,Image& image) const
+{
+    tjhandle handle = ::tjInitDecompress();
+    
+    if(!handle)
+    {
+        std::cerr << "TurboJpegImageDecoder::decode:  error creating decompressor" << std::endl;
+        return false;
+    }
+    
+    
+    int fileWidth,fileHeight,subsampling,colorspace;
+    
+    if(::tjDecompressHeader3(handle,data,(unsigned long) length,&fileWidth,&fileHeight,&subsampling,&colorspace) != 0)
+    {
+        std::cerr << "TurboJpegImageDecoder::decode:  error reading header:  " << ::tjGetErrorStr2(handle) << std::endl;
+        
+        ::tjDestroy(handle);
+        return false;
+    }
+    
+    
+    // take the smallest scaling factor that's still at least as wide as we
+    // want
+    int imageWidth = fileWidth;
+    int imageHeight = fileHeight;
+    
+    if(width > 0  &&  fileWidth > width)
+    {
+        int count = 0;
+        tjscalingfactor *factors = ::tjGetScalingFactors(&count);
+        
+        for(int index = 0;factors  &&  index < count;++index)
+        {
+            int scaledWidth = TJSCALED(fileWidth,factors[index]);
+            
+            if(scaledWidth >= width  &&  scaledWidth < imageWidth)
+            {
+                imageWidth = scaledWidth;
+                imageHeight = TJSCALED(fileHeight,factors[index]);
+            }
+        }
+    }
+    
+    bool gray = colorspace == TJCS_GRAY;
+    
+    if(!image.create(imageWidth,imageHeight,gray ? 8 : 24))
+    {
+        ::tjDestroy(handle);
+        return false;
+    }
+    
+    
+    // the faster, slightly less accurate DCT makes no visible difference at
+    // the size tiles are drawn
+    int result = ::tjDecompress2(handle,data,(unsigned long) length,(unsigned char *) image.pixelData(),imageWidth,0,imageHeight,
+                                 gray ? TJPF_GRAY : TJPF_RGB,TJFLAG_BOTTOMUP | TJFLAG_FASTDCT);
+    
+    // a warning still leaves a picture, of a JPEG that's a bit damaged
+    if(result != 0  &&  ::tjGetErrorCode(handle) != TJERR_WARNING)
+    {
+        std::cerr << "TurboJpegImageDecoder::decode:  error decoding image:  " << ::tjGetErrorStr2(handle) << std::endl;
+        
+        ::tjDestroy(handle);
+        return false;
+    }
+    
+    ::tjDestroy(handle);
+    
+    return true;
+}
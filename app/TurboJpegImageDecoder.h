@@ -0,0 +1,9 @@
+#pragma once
+#include "ImageDecoder.h"
+
+
+class TurboJpegImageDecoder : public ImageDecoder
+{
+    public:
+        bool decode(const unsigned char *data,int length,int width,Image& image) const;
+};
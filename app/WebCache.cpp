@@ -0,0 +1,237 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "CacheFiles.h"
+#include "WebCache.h"
+
+
+struct WebCache::PrivateImpl
+{
+    std::string directory;
+    
+    std::atomic<int> hits;
+    std::atomic<int> revalidations;
+    std::atomic<int> misses;
+};
+
+
+WebCache::WebCache() :
+    m_impl(new PrivateImpl)
+{
+    if(m_impl)
+    {
+        m_impl->hits = 0;
+        m_impl->revalidations = 0;
+        m_impl->misses = 0;
+    }
+}
+
+
+WebCache::~WebCache()
+{
+    if(m_impl)
+    {
+        close();
+        delete m_impl;
+    }
+}
+
+
+bool WebCache::valid() const
+{
+    if(!m_impl)
+        return false;
+    
+    return !m_impl->directory.empty();
+}
+
+
+bool WebCache::open(const std::string& directory)
+{
+    if(!m_impl)
+        return false;
+    
+    close();
+    
+    
+    if(!makeDirectory(directory))
+    {
+        std::cerr << "WebCache::open:  error opening cache directory '" << directory << "'" << std::endl;
+        return false;
+    }
+    
+    m_impl->directory = directory;
+    
+    return true;
+}
+
+
+void WebCache::close()
+{
+    if(!m_impl)
+        return;
+    
+    
+    m_impl->directory.clear();
+}
+
+
+int WebCache::hits() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->hits;
+}
+
+
+int WebCache::revalidations() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->revalidations;
+}
+
+
+int WebCache::misses() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->misses;
+}
+
+
+bool WebCache::lookup(const std::string& url,Entry& entry) const
+{
+    // this function reads the validators and expiry for a URL, but not the
+    // body.  the body is only needed once we know the entry is usable
+    
+    if(!valid())
+        return false;
+    
+    
+    std::ifstream file(m_impl->directory + "/" + hashName(url) + ".meta",std::ios_base::binary);
+    
+    if(!file.is_open())
+        return false;
+    
+    
+    std::string storedUrl;
+    std::string expires;
+    
+    if(!std::getline(file,storedUrl)  ||  storedUrl != url)
+        return false;
+    
+    if(!std::getline(file,entry.etag)  ||  !std::getline(file,entry.lastModified)  ||  !std::getline(file,expires))
+        return false;
+    
+    entry.expires = std::atoll(expires.c_str());
+    
+    return true;
+}
+
+
+bool WebCache::load(const std::string& url,std::string& data) const
+{
+    if(!valid())
+        return false;
+    
+    
+    std::ifstream file(m_impl->directory + "/" + hashName(url) + ".body",std::ios_base::binary);
+    
+    if(!file.is_open())
+        return false;
+    
+    // read straight into the caller's buffer, sized once up front
+    file.seekg(0,std::ios::end);
+    std::streamoff size = file.tellg();
+    file.seekg(0,std::ios::beg);
+    
+    data.resize((size_t) size);
+    file.read(&data[0],size);
+    
+    return (bool) file;
+}
+
+
+bool WebCache::store(const std::string& url,const Entry& entry,const std::string& data)
+{
+    // the body goes down first, so a metadata file always has its body next
+    // to it
+    
+    if(!valid())
+        return false;
+    
+    
+    if(!replaceFile(m_impl->directory + "/" + hashName(url) + ".body",std::string(),data.data(),data.size()))
+    {
+        std::cerr << "WebCache::store:  error writing cache entry for '" << url << "'" << std::endl;
+        return false;
+    }
+    
+    return refresh(url,entry);
+}
+
+
+bool WebCache::refresh(const std::string& url,const Entry& entry)
+{
+    if(!valid())
+        return false;
+    
+    
+    std::ostringstream meta;
+    meta << url << '\n'
+         << entry.etag << '\n'
+         << entry.lastModified << '\n'
+         << entry.expires << '\n';
+    
+    if(!replaceFile(m_impl->directory + "/" + hashName(url) + ".meta",meta.str(),nullptr,0))
+    {
+        std::cerr << "WebCache::refresh:  error writing cache entry for '" << url << "'" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+
+void WebCache::remove(const std::string& url)
+{
+    // the metadata goes first, so there's never a file that would have us
+    // validate a body that isn't there
+    
+    if(!valid())
+        return;
+    
+    
+    std::string filename = m_impl->directory + "/" + hashName(url);
+    
+    std::remove((filename + ".meta").c_str());
+    std::remove((filename + ".body").c_str());
+}
+
+
+void WebCache::countHit()
+{
+    if(m_impl)
+        ++m_impl->hits;
+}
+
+
+void WebCache::countRevalidation()
+{
+    if(m_impl)
+        ++m_impl->revalidations;
+}
+
+
+void WebCache::countMiss()
+{
+    if(m_impl)
+        ++m_impl->misses;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+
+
+class WebCache
+{
+    public:
+        WebCache();
+        ~WebCache();
+        
+        bool valid() const;
+        
+        bool open(const std::string& directory);
+        void close();
+        
+        int hits() const;
+        int revalidations() const;
+        int misses() const;
+        
+    private:
+        friend class WebSupplicant;
+        
+        struct Entry
+        {
+            std::string etag;
+            std::string lastModified;
+            long long expires;
+        };
+        
+        bool lookup(const std::string& url,Entry& entry) const;
+        bool load(const std::string& url,std::string& data) const;
+        bool store(const std::string& url,const Entry& entry,const std::string& data);
+        bool refresh(const std::string& url,const Entry& entry);
+        void remove(const std::string& url);
+        
+        void countHit();
+        void countRevalidation();
+        void countMiss();
+        
+        
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -0,0 +1,763 @@
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "CancellationToken.h"
+#include "curl/curl.h"
+#include "WebDispatcher.h"
+#include "WebServices.h"
+#include "WebSupplicant.h"
+
+
+static std::string hostName(const std::string& url)
+{
+    // pull the host (and port, if any) out of a URL.  we only use this to
+    // count transfers per host, so it doesn't need to be a full parser
+    
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    
+    size_t end = url.find_first_of("/?#",start);
+    
+    if(end == std::string::npos)
+        end = url.size();
+    
+    return url.substr(start,end - start);
+}
+
+
+static long streamWeight(WebDispatcher::Priority priority)
+{
+    // HTTP/2 stream weights, so a multiplexed connection gives most of its
+    // bandwidth to the transfers we care about most
+    
+    static const long weights[WebDispatcher::PriorityCount] = { 256,64,16,1 };
+    return weights[priority];
+}
+
+
+struct Transfer
+{
+    std::string url;
+    std::string host;
+    WebDispatcher::Priority priority;
+    bool hasDeadline;
+    std::chrono::steady_clock::time_point deadline;
+    std::unique_ptr<WebSupplicant> supplicant;
+};
+
+struct WebDispatcher::PrivateImpl
+{
+    CURLM *multi;
+    
+    int maxTransfers;
+    int maxHostTransfers;
+    
+    WebCache *cache;
+    CancellationToken cancellation;
+    
+    std::deque<std::string> queued[PriorityCount];
+    std::unordered_map<std::string,Priority> queuedPriorities;
+    
+    std::map<CURL *,Transfer> active;
+    std::unordered_map<std::string,CURL *> activeHandles;
+    std::unordered_map<std::string,std::chrono::steady_clock::time_point> deadlines;
+    std::unordered_map<std::string,WebSupplicant::Sink> sinks;
+    std::map<std::string,int> hostTransfers;
+    std::deque<Response> completed;
+    
+    std::vector<std::unique_ptr<WebSupplicant>> idle;
+    std::vector<std::string> buffers;
+};
+
+
+WebDispatcher::WebDispatcher() :
+    m_impl(new PrivateImpl)
+{
+    WebServices::start();
+    
+    
+    if(m_impl)
+    {
+        m_impl->multi = ::curl_multi_init();
+        
+        if(m_impl->multi)
+            ::curl_multi_setopt(m_impl->multi,CURLMOPT_PIPELINING,CURLPIPE_MULTIPLEX);
+        
+        m_impl->maxTransfers = 16;
+        m_impl->maxHostTransfers = 6;
+        
+        m_impl->cache = nullptr;
+    }
+}
+
+
+WebDispatcher::~WebDispatcher()
+{
+    if(m_impl)
+    {
+        // abandon anything still in flight.  the easy handles have to leave
+        // the multi handle before either of them is cleaned up
+        for(auto& transfer : m_impl->active)
+            ::curl_multi_remove_handle(m_impl->multi,transfer.first);
+        
+        m_impl->active.clear();
+        m_impl->activeHandles.clear();
+        m_impl->idle.clear();
+        
+        if(m_impl->multi)
+            ::curl_multi_cleanup(m_impl->multi);
+        
+        delete m_impl;
+    }
+}
+
+
+int WebDispatcher::maxTransfers() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->maxTransfers;
+}
+
+
+void WebDispatcher::setMaxTransfers(int count)
+{
+    if(!m_impl)
+        return;
+    
+    m_impl->maxTransfers = count < 1 ? 1 : count;
+}
+
+
+int WebDispatcher::maxHostTransfers() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->maxHostTransfers;
+}
+
+
+void WebDispatcher::setMaxHostTransfers(int count)
+{
+    if(!m_impl)
+        return;
+    
+    m_impl->maxHostTransfers = count < 1 ? 1 : count;
+}
+
+
+WebCache *WebDispatcher::cache() const
+{
+    if(!m_impl)
+        return nullptr;
+    
+    return m_impl->cache;
+}
+
+
+void WebDispatcher::setCache(WebCache *cache)
+{
+    if(!m_impl)
+        return;
+    
+    m_impl->cache = cache;
+}
+
+
+void WebDispatcher::setCancellation(const CancellationToken& cancellation)
+{
+    // once this token is cancelled, everything pending is dropped and next()
+    // returns false straight away
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->cancellation = cancellation;
+}
+
+
+bool WebDispatcher::request(const std::string& url,Priority priority,int timeout)
+{
+    // queue a transfer.  it will be started by next() once there's room under
+    // the transfer caps, with higher priorities going first.  requesting a URL
+    // that is already pending doesn't fetch it twice.  it just moves it to the
+    // new priority.  a positive timeout (in milliseconds) is a deadline for
+    // the transfer, counting the time it spends queued.  a transfer that
+    // misses it completes unsuccessfully
+    
+    if(!m_impl)
+        return false;
+    
+    if(!m_impl->multi)
+        return false;
+    
+    if(priority < PriorityVisible  ||  priority >= PriorityCount)
+        return false;
+    
+    if(timeout > 0  &&  m_impl->deadlines.find(url) == m_impl->deadlines.end()  &&  m_impl->activeHandles.find(url) == m_impl->activeHandles.end())
+        m_impl->deadlines[url] = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    
+    
+    auto queuedIndex = m_impl->queuedPriorities.find(url);
+    
+    if(queuedIndex != m_impl->queuedPriorities.end())
+    {
+        if(queuedIndex->second != priority)
+        {
+            std::deque<std::string>& queue = m_impl->queued[queuedIndex->second];
+            queue.erase(std::find(queue.begin(),queue.end(),url));
+            
+            m_impl->queued[priority].push_back(url);
+            queuedIndex->second = priority;
+        }
+        
+        return true;
+    }
+    
+    
+    auto activeIndex = m_impl->activeHandles.find(url);
+    
+    if(activeIndex != m_impl->activeHandles.end())
+    {
+        Transfer& transfer = m_impl->active[activeIndex->second];
+        
+        if(transfer.priority != priority)
+        {
+            transfer.priority = priority;
+            ::curl_easy_setopt(activeIndex->second,CURLOPT_STREAM_WEIGHT,streamWeight(priority));
+        }
+        
+        return true;
+    }
+    
+    
+    for(const Response& response : m_impl->completed)
+    {
+        if(response.url == url)
+            return true;
+    }
+    
+    
+    m_impl->queued[priority].push_back(url);
+    m_impl->queuedPriorities[url] = priority;
+    
+    return true;
+}
+
+
+bool WebDispatcher::stream(const std::string& url,const WebSupplicant::Sink& sink,Priority priority,int timeout)
+{
+    // like request(), but the body goes to the sink as it arrives rather than
+    // into the response.  if the URL is already pending, it keeps the sink it
+    // already has
+    
+    if(!m_impl)
+        return false;
+    
+    if(!request(url,priority,timeout))
+        return false;
+    
+    if(m_impl->sinks.find(url) == m_impl->sinks.end())
+        m_impl->sinks[url] = sink;
+    
+    return true;
+}
+
+
+bool WebDispatcher::cancel(const std::string& url)
+{
+    // drop a transfer, whether it's still queued or already in flight.  it
+    // won't come back through next()
+    
+    if(!m_impl)
+        return false;
+    
+    
+    auto queuedIndex = m_impl->queuedPriorities.find(url);
+    
+    if(queuedIndex != m_impl->queuedPriorities.end())
+    {
+        std::deque<std::string>& queue = m_impl->queued[queuedIndex->second];
+        queue.erase(std::find(queue.begin(),queue.end(),url));
+        
+        m_impl->queuedPriorities.erase(queuedIndex);
+        m_impl->deadlines.erase(url);
+        m_impl->sinks.erase(url);
+        return true;
+    }
+    
+    
+    auto activeIndex = m_impl->activeHandles.find(url);
+    
+    if(activeIndex != m_impl->activeHandles.end())
+    {
+        abortTransfer(activeIndex->second);
+        m_impl->sinks.erase(url);
+        return true;
+    }
+    
+    return false;
+}
+
+
+int WebDispatcher::cancel(Priority priority)
+{
+    // drop every pending transfer at this priority or lower, and return how
+    // many there were
+    
+    if(!m_impl)
+        return 0;
+    
+    
+    int count = 0;
+    
+    for(int index = std::max((int) priority,0);index < PriorityCount;++index)
+    {
+        for(const std::string& url : m_impl->queued[index])
+        {
+            m_impl->queuedPriorities.erase(url);
+            m_impl->deadlines.erase(url);
+            m_impl->sinks.erase(url);
+        }
+        
+        count += (int) m_impl->queued[index].size();
+        m_impl->queued[index].clear();
+    }
+    
+    
+    std::vector<CURL *> handles;
+    
+    for(auto& transfer : m_impl->active)
+    {
+        if(transfer.second.priority >= priority)
+            handles.push_back(transfer.first);
+    }
+    
+    for(CURL *handle : handles)
+    {
+        m_impl->sinks.erase(m_impl->active[handle].url);
+        abortTransfer(handle);
+    }
+    
+    return count + (int) handles.size();
+}
+
+
+void WebDispatcher::demote(Priority priority)
+{
+    // lower every pending transfer to this priority, leaving the ones that
+    // are already lower alone.  the idea is to demote everything when the
+    // view changes, then request what's wanted again at its new priority, so
+    // anything that's no longer wanted sinks to the bottom
+    
+    if(!m_impl)
+        return;
+    
+    if(priority < PriorityVisible  ||  priority >= PriorityCount)
+        return;
+    
+    
+    std::deque<std::string> demoted;
+    
+    for(int index = PriorityVisible;index <= priority;++index)
+    {
+        for(const std::string& url : m_impl->queued[index])
+        {
+            demoted.push_back(url);
+            m_impl->queuedPriorities[url] = priority;
+        }
+        
+        m_impl->queued[index].clear();
+    }
+    
+    m_impl->queued[priority].swap(demoted);
+    
+    
+    for(auto& transfer : m_impl->active)
+    {
+        if(transfer.second.priority < priority)
+        {
+            transfer.second.priority = priority;
+            ::curl_easy_setopt(transfer.first,CURLOPT_STREAM_WEIGHT,streamWeight(priority));
+        }
+    }
+}
+
+
+int WebDispatcher::pending() const
+{
+    // the number of transfers that have been requested but not yet handed
+    // back through next()
+    
+    if(!m_impl)
+        return 0;
+    
+    return (int)(m_impl->queuedPriorities.size() + m_impl->active.size() + m_impl->completed.size());
+}
+
+
+bool WebDispatcher::next(Response& response,int timeout)
+{
+    // this function drives the transfers until one of them completes, then
+    // hands it back.  completions come back in the order they finish, not the
+    // order they were requested.  it returns false if there is nothing left to
+    // wait for, or if the timeout (in milliseconds) expires first.  a negative
+    // timeout waits as long as it takes
+    
+    if(!m_impl)
+        return false;
+    
+    if(!m_impl->multi)
+        return false;
+    
+    
+    int remaining = timeout;
+    
+    while(m_impl->completed.empty())
+    {
+        if(m_impl->cancellation.cancelled())
+        {
+            cancel(PriorityVisible);
+            return false;
+        }
+        
+        startTransfers();
+        
+        if(m_impl->active.empty())
+            break;
+        
+        
+        int running;
+        CURLMcode result = ::curl_multi_perform(m_impl->multi,&running);
+        
+        if(result != CURLM_OK)
+        {
+            std::cerr << "WebDispatcher::next:  error performing transfers:  "
+                      << ::curl_multi_strerror(result)
+                      << std::endl;
+            
+            return false;
+        }
+        
+        collectTransfers();
+        
+        if(!m_impl->completed.empty())
+            break;
+        
+        
+        // nothing finished, so sleep until there's socket activity.  we poll
+        // in short slices so the timeout is honored without a clock, and a
+        // cancellation is noticed within a slice
+        if(timeout >= 0  &&  remaining <= 0)
+            return false;
+        
+        int slice = timeout < 0 ? 20 : std::min(remaining,20);
+        
+        ::curl_multi_poll(m_impl->multi,nullptr,0,slice,nullptr);
+        
+        if(timeout >= 0)
+            remaining -= slice;
+    }
+    
+    
+    if(m_impl->completed.empty())
+        return false;
+    
+    response = std::move(m_impl->completed.front());
+    m_impl->completed.pop_front();
+    
+    m_impl->sinks.erase(response.url);
+    
+    return true;
+}
+
+
+void WebDispatcher::recycle(Response& response)
+{
+    // hand a response body back once the caller is done with it, so its
+    // memory can be reused by a later transfer instead of being reallocated
+    
+    if(!m_impl)
+        return;
+    
+    // a body that was swapped out or streamed leaves nothing worth keeping,
+    // and would only take a slot from a buffer that has some memory
+    if(response.data.capacity() == 0  ||  (int) m_impl->buffers.size() >= m_impl->maxTransfers)
+        return;
+    
+    
+    response.data.clear();
+    
+    m_impl->buffers.push_back(std::string());
+    m_impl->buffers.back().swap(response.data);
+}
+
+
+void WebDispatcher::startTransfers()
+{
+    // walk the queues from the highest priority down and start every transfer
+    // that fits under both the overall cap and the cap for its host.  a
+    // visible transfer that doesn't fit may bump a less important one out of
+    // its slot.  anything else that doesn't fit stays queued in its original
+    // position
+    
+    for(int priority = PriorityVisible;priority < PriorityCount;++priority)
+    {
+        std::deque<std::string>& queue = m_impl->queued[priority];
+        
+        for(auto index = queue.begin();index != queue.end();)
+        {
+            std::string host = hostName(*index);
+            
+            bool full = (int) m_impl->active.size() >= m_impl->maxTransfers  ||
+                        m_impl->hostTransfers[host] >= m_impl->maxHostTransfers;
+            
+            if(full  &&  priority == PriorityVisible)
+                full = !preempt(host);
+            
+            if(full)
+            {
+                ++index;
+                continue;
+            }
+            
+            
+            std::string url = *index;
+            
+            m_impl->queuedPriorities.erase(url);
+            index = queue.erase(index);
+            
+            
+            std::unique_ptr<WebSupplicant> supplicant;
+            
+            if(m_impl->idle.empty())
+            {
+                supplicant.reset(new WebSupplicant);
+            }
+            else
+            {
+                supplicant = std::move(m_impl->idle.back());
+                m_impl->idle.pop_back();
+            }
+            
+            
+            CURL *handle = (CURL *) supplicant->handle();
+            supplicant->setCache(m_impl->cache);
+            supplicant->setCancellation(m_impl->cancellation);
+            
+            auto sinkIndex = m_impl->sinks.find(url);
+            supplicant->setSink(sinkIndex != m_impl->sinks.end() ? sinkIndex->second : WebSupplicant::Sink());
+            
+            
+            // whatever is left of the deadline becomes the transfer's timeout.
+            // if there's nothing left, it fails without being started
+            bool hasDeadline = false;
+            std::chrono::steady_clock::time_point deadline;
+            int transferTimeout = 0;
+            
+            auto deadlineIndex = m_impl->deadlines.find(url);
+            
+            if(deadlineIndex != m_impl->deadlines.end())
+            {
+                hasDeadline = true;
+                deadline = deadlineIndex->second;
+                m_impl->deadlines.erase(deadlineIndex);
+                
+                transferTimeout = (int) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                
+                if(transferTimeout <= 0)
+                {
+                    std::cerr << "WebDispatcher::startTransfers:  error starting transfer for '" << url << "':  deadline passed" << std::endl;
+                    
+                    Response response;
+                    response.url = url;
+                    response.success = false;
+                    response.wireBytes = 0;
+                    response.decodedBytes = 0;
+                    m_impl->completed.push_back(std::move(response));
+                    
+                    m_impl->idle.push_back(std::move(supplicant));
+                    continue;
+                }
+            }
+            
+            supplicant->setTimeout(transferTimeout);
+            
+            bool prepared = handle  &&  supplicant->prepare(url);
+            
+            
+            // a fresh cache entry completes the transfer without touching the
+            // network, so it doesn't count against the caps
+            if(prepared  &&  supplicant->cached())
+            {
+                Response response;
+                response.url = url;
+                response.success = supplicant->finish(CURLE_OK,response.data);
+                response.wireBytes = supplicant->wireBytes();
+                response.decodedBytes = supplicant->decodedBytes();
+                m_impl->completed.push_back(std::move(response));
+                
+                m_impl->idle.push_back(std::move(supplicant));
+                continue;
+            }
+            
+            if(prepared)
+                ::curl_easy_setopt(handle,CURLOPT_STREAM_WEIGHT,streamWeight((Priority) priority));
+            
+            if(!prepared  ||  ::curl_multi_add_handle(m_impl->multi,handle) != CURLM_OK)
+            {
+                std::cerr << "WebDispatcher::startTransfers:  error starting transfer for '" << url << "'" << std::endl;
+                
+                Response response;
+                response.url = url;
+                response.success = false;
+                response.wireBytes = 0;
+                response.decodedBytes = 0;
+                m_impl->completed.push_back(std::move(response));
+                
+                if(handle)
+                    m_impl->idle.push_back(std::move(supplicant));
+                
+                continue;
+            }
+            
+            
+            Transfer& transfer = m_impl->active[handle];
+            transfer.url = url;
+            transfer.host = host;
+            transfer.priority = (Priority) priority;
+            transfer.hasDeadline = hasDeadline;
+            transfer.deadline = deadline;
+            transfer.supplicant = std::move(supplicant);
+            
+            m_impl->activeHandles[url] = handle;
+            ++m_impl->hostTransfers[host];
+        }
+    }
+}
+
+
+void WebDispatcher::collectTransfers()
+{
+    // move every finished transfer from the multi handle to the completed
+    // queue, and put its easy handle back in the idle pool for reuse
+    
+    int messages;
+    CURLMsg *message;
+    
+    while((message = ::curl_multi_info_read(m_impl->multi,&messages)))
+    {
+        if(message->msg != CURLMSG_DONE)
+            continue;
+        
+        
+        CURL *handle = message->easy_handle;
+        CURLcode result = message->data.result;
+        
+        ::curl_multi_remove_handle(m_impl->multi,handle);
+        
+        
+        auto index = m_impl->active.find(handle);
+        
+        if(index == m_impl->active.end())
+            continue;
+        
+        Transfer& transfer = index->second;
+        
+        // the body is swapped into the response, and the recycled buffer we
+        // give it goes back to the supplicant for its next transfer
+        Response response;
+        response.url = transfer.url;
+        
+        if(!m_impl->buffers.empty())
+        {
+            response.data.swap(m_impl->buffers.back());
+            m_impl->buffers.pop_back();
+        }
+        
+        response.success = transfer.supplicant->finish(result,response.data);
+        response.wireBytes = transfer.supplicant->wireBytes();
+        response.decodedBytes = transfer.supplicant->decodedBytes();
+        m_impl->completed.push_back(std::move(response));
+        
+        if(--m_impl->hostTransfers[transfer.host] <= 0)
+            m_impl->hostTransfers.erase(transfer.host);
+        
+        m_impl->activeHandles.erase(transfer.url);
+        m_impl->idle.push_back(std::move(transfer.supplicant));
+        m_impl->active.erase(index);
+    }
+}
+
+
+bool WebDispatcher::preempt(const std::string& host)
+{
+    // make room for a visible transfer to this host by bumping the least
+    // important prefetch or background transfer back to the front of its
+    // queue.  if the host is at its cap, the bumped transfer has to be to the
+    // same host, otherwise any will do
+    
+    bool hostFull = m_impl->hostTransfers[host] >= m_impl->maxHostTransfers;
+    
+    CURL *victim = nullptr;
+    Priority victimPriority = PriorityAdjacent;
+    
+    for(auto& transfer : m_impl->active)
+    {
+        if(hostFull  &&  transfer.second.host != host)
+            continue;
+        
+        if(transfer.second.priority > victimPriority)
+        {
+            victim = transfer.first;
+            victimPriority = transfer.second.priority;
+        }
+    }
+    
+    if(!victim)
+        return false;
+    
+    
+    Transfer& transfer = m_impl->active[victim];
+    std::string url = transfer.url;
+    
+    if(transfer.hasDeadline)
+        m_impl->deadlines[url] = transfer.deadline;
+    
+    abortTransfer(victim);
+    
+    m_impl->queued[victimPriority].push_front(url);
+    m_impl->queuedPriorities[url] = victimPriority;
+    
+    return true;
+}
+
+
+void WebDispatcher::abortTransfer(void *handle)
+{
+    // take a transfer out of the multi handle part way through.  nothing is
+    // reported for it, and its easy handle goes back in the idle pool
+    
+    auto index = m_impl->active.find((CURL *) handle);
+    
+    if(index == m_impl->active.end())
+        return;
+    
+    Transfer& transfer = index->second;
+    
+    ::curl_multi_remove_handle(m_impl->multi,(CURL *) handle);
+    
+    if(--m_impl->hostTransfers[transfer.host] <= 0)
+        m_impl->hostTransfers.erase(transfer.host);
+    
+    m_impl->activeHandles.erase(transfer.url);
+    m_impl->idle.push_back(std::move(transfer.supplicant));
+    m_impl->active.erase(index);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include "WebSupplicant.h"
+
+
+class CancellationToken;
+class WebCache;
+
+class WebDispatcher
+{
+    public:
+        enum Priority
+        {
+            PriorityVisible,
+            PriorityAdjacent,
+            PriorityPrefetch,
+            PriorityBackground,
+            PriorityCount
+        };
+        
+        struct Response
+        {
+            std::string url;
+            bool success;
+            std::string data;
+            long long wireBytes;
+            long long decodedBytes;
+        };
+        
+    public:
+        WebDispatcher();
+        ~WebDispatcher();
+        
+        int maxTransfers() const;
+        void setMaxTransfers(int count);
+        
+        int maxHostTransfers() const;
+        void setMaxHostTransfers(int count);
+        
+        WebCache *cache() const;
+        void setCache(WebCache *cache);
+        
+        void setCancellation(const CancellationToken& cancellation);
+        
+        bool request(const std::string& url,Priority priority = PriorityVisible,int timeout = 0);
+        bool stream(const std::string& url,const WebSupplicant::Sink& sink,Priority priority = PriorityVisible,int timeout = 0);
+        
+        bool cancel(const std::string& url);
+        int cancel(Priority priority);
+        void demote(Priority priority);
+        
+        int pending() const;
+        
+        bool next(Response& response,int timeout = -1);
+        void recycle(Response& response);
+        
+    private:
+        void startTransfers();
+        void collectTransfers();
+        bool preempt(const std::string& host);
+        void abortTransfer(void *handle);
+        
+        
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
+};
@@ -1,9 +1,62 @@
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "CancellationToken.h"
 #include "curl/curl.h"
 #include "WebServices.h"
+#include "WebSupplicant.h"
 
 
-WebServices::WebServices()
+// the hosts we know we'll be talking to.  connecting to them as soon as the
+// services start means the DNS lookup and the TCP and TLS handshakes are out of
+// the way before the first real request is made
+
+static const char *knownHosts[] =
+{
+    "https://cd-static.bamgrid.com/",
+    "https://prod-ripcut-delivery.disney-plus.net/"
+};
+
+
+static void connectThread(std::string url,CancellationToken cancellation)
+{
+    WebSupplicant supplicant;
+    supplicant.setCancellation(cancellation);
+    supplicant.connect(url);
+}
+
+
+static void lockCallback(CURL * /*handle*/,curl_lock_data data,curl_lock_access /*access*/,void *opaque)
+{
+    // the share hands us the array of locks it was given, one per kind of
+    // data it shares
+    
+    std::mutex *locks = (std::mutex *) opaque;
+    locks[data].lock();
+}
+
+
+static void unlockCallback(CURL * /*handle*/,curl_lock_data data,void *opaque)
+{
+    std::mutex *locks = (std::mutex *) opaque;
+    locks[data].unlock();
+}
+
+
+struct WebServices::PrivateImpl
+{
+    CURLSH *share;
+    std::mutex locks[CURL_LOCK_DATA_LAST];
+    
+    std::mutex preconnectMutex;
+    std::vector<std::thread> preconnects;
+    CancellationToken cancellation;
+};
+
+
+WebServices::WebServices() :
+    m_impl(new PrivateImpl)
 {
     CURLcode result = ::curl_global_init(CURL_GLOBAL_DEFAULT);
     
@@ -11,16 +64,100 @@ WebServices::WebServices()
         std::cerr << "WebServices::WebServices:  error initializing CURL:  "
                   << ::curl_easy_strerror(result)
                   << std::endl;
+    
+    
+    if(!m_impl)
+        return;
+    
+    
+    // create the share handle that every easy handle in the process draws
+    // its DNS cache, TLS sessions and connections from
+    m_impl->share = ::curl_share_init();
+    
+    if(m_impl->share)
+    {
+        ::curl_share_setopt(m_impl->share,CURLSHOPT_LOCKFUNC,lockCallback);
+        ::curl_share_setopt(m_impl->share,CURLSHOPT_UNLOCKFUNC,unlockCallback);
+        ::curl_share_setopt(m_impl->share,CURLSHOPT_USERDATA,(void *) m_impl->locks);
+        
+        ::curl_share_setopt(m_impl->share,CURLSHOPT_SHARE,CURL_LOCK_DATA_DNS);
+        ::curl_share_setopt(m_impl->share,CURLSHOPT_SHARE,CURL_LOCK_DATA_SSL_SESSION);
+        ::curl_share_setopt(m_impl->share,CURLSHOPT_SHARE,CURL_LOCK_DATA_CONNECT);
+    }
+    else
+    {
+        std::cerr << "WebServices::WebServices:  error creating share handle" << std::endl;
+    }
+    
+    
+    // we can't go through preconnect() here since the instance isn't finished
+    // being constructed yet
+    for(const char *url : knownHosts)
+        m_impl->preconnects.push_back(std::thread(connectThread,std::string(url),m_impl->cancellation));
 }
 
 
 WebServices::~WebServices()
 {
+    if(m_impl)
+    {
+        // the preconnects hold easy handles on the share, so they have to
+        // finish before it goes away.  there's no point waiting on a slow
+        // host at exit, so they're cancelled first
+        m_impl->cancellation.cancel();
+        
+        for(auto& thread : m_impl->preconnects)
+            thread.join();
+        
+        if(m_impl->share)
+            ::curl_share_cleanup(m_impl->share);
+        
+        delete m_impl;
+    }
+    
+    
     ::curl_global_cleanup();
 }
 
 
 void WebServices::start()
+{
+    instance();
+}
+
+
+void WebServices::preconnect(const std::string& url)
+{
+    // open a connection to the host of the URL in the background.  the
+    // connection, its DNS entry and TLS session are left in the shared pool
+    // for the next request to pick up
+    
+    PrivateImpl *impl = instance().m_impl;
+    
+    if(!impl)
+        return;
+    
+    
+    std::lock_guard<std::mutex> lock(impl->preconnectMutex);
+    
+    impl->preconnects.push_back(std::thread(connectThread,url,impl->cancellation));
+}
+
+
+void *WebServices::share()
+{
+    PrivateImpl *impl = instance().m_impl;
+    
+    if(!impl)
+        return nullptr;
+    
+    return impl->share;
+}
+
+
+WebServices& WebServices::instance()
 {
     static WebServices services;
+    return services;
 }
+
@@ -1,12 +1,23 @@
 #pragma once
+#include <string>
 
 
 class WebServices
 {
     public:
         static void start();
+        
+        static void preconnect(const std::string& url);
+        
+        static void *share();
     
     private:
         WebServices();
         ~WebServices();
+        
+        static WebServices& instance();
+        
+        
+        struct PrivateImpl;
+        PrivateImpl *m_impl;
 };
@@ -1,6 +1,11 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <ctime>
 #include <iomanip>
 #include <iostream>
 #include "curl/curl.h"
+#include "WebCache.h"
 #include "WebSupplicant.h"
 #include "WebServices.h"
 
@@ -11,7 +16,7 @@
     \
         if(result != CURLE_OK)  \
         {  \
-            std::cerr << "WebSupplicant::request:  error setting option:  "  \
+            std::cerr << "WebSupplicant::" << __func__ << ":  error setting option:  "  \
                       << ::curl_easy_strerror(result)  \
                       << std::endl;  \
         \
@@ -68,11 +73,140 @@ static void hexDump(unsigned char *buffer,int length)
 }
 
 
+struct ResponseBody
+{
+    std::string *data;
+    const WebSupplicant::Sink *sink;
+    bool keep;
+    long long bytes;
+};
+
+
 static size_t writeCallback(void *contents,size_t size,size_t nmemb,void *opaque)
 {
+    // the body goes to the sink if there is one, and is only kept as well if
+    // the cache needs it.  a sink that returns false aborts the transfer
+    
     size_t totalBytes = size * nmemb;
-    std::string *data = (std::string *) opaque;
-    data->insert(data->end(),(const uint8_t *) contents,(const uint8_t *) contents + totalBytes);
+    ResponseBody *body = (ResponseBody *) opaque;
+    
+    if(*body->sink  &&  !(*body->sink)((const char *) contents,totalBytes))
+        return 0;
+    
+    if(body->keep)
+        body->data->append((const char *) contents,totalBytes);
+    
+    body->bytes += totalBytes;
+    
+    return totalBytes;
+}
+
+
+struct ResponseHeaders
+{
+    std::string *body;
+    
+    std::string etag;
+    std::string lastModified;
+    long long maxAge;
+    bool noStore;
+    bool noCache;
+    
+    long long contentLength;
+    bool contentEncoded;
+};
+
+
+static void resetHeaders(ResponseHeaders& headers)
+{
+    headers.etag.clear();
+    headers.lastModified.clear();
+    headers.maxAge = -1;
+    headers.noStore = false;
+    headers.noCache = false;
+    headers.contentLength = -1;
+    headers.contentEncoded = false;
+}
+
+
+static size_t headerCallback(char *buffer,size_t size,size_t nitems,void *opaque)
+{
+    // curl hands us one header line at a time.  we only keep the ones the
+    // cache needs to validate and expire its entries
+    
+    size_t totalBytes = size * nitems;
+    ResponseHeaders *headers = (ResponseHeaders *) opaque;
+    
+    std::string line(buffer,totalBytes);
+    
+    while(!line.empty()  &&  (line.back() == '\r'  ||  line.back() == '\n'))
+        line.pop_back();
+    
+    
+    // a status line starts a new set of headers, which happens after a
+    // redirect or an interim response
+    if(line.compare(0,5,"HTTP/") == 0)
+    {
+        resetHeaders(*headers);
+        return totalBytes;
+    }
+    
+    // a blank line ends them.  the body is sized up front from its length so
+    // the write callback never has to grow it, but only if it isn't encoded,
+    // since then the length is that of the compressed body rather than of
+    // what curl hands us.  the cap keeps a bogus length from reserving the
+    // whole address space
+    if(line.empty())
+    {
+        if(headers->body  &&  !headers->contentEncoded  &&
+           headers->contentLength > 0  &&  headers->contentLength <= 256 * 1024 * 1024)
+            headers->body->reserve((size_t) headers->contentLength);
+        
+        return totalBytes;
+    }
+    
+    size_t colon = line.find(':');
+    
+    if(colon == std::string::npos)
+        return totalBytes;
+    
+    
+    std::string name = line.substr(0,colon);
+    std::transform(name.begin(),name.end(),name.begin(),::tolower);
+    
+    size_t start = line.find_first_not_of(" \t",colon + 1);
+    std::string value = start == std::string::npos ? std::string() : line.substr(start);
+    
+    if(name == "etag")
+    {
+        headers->etag = value;
+    }
+    else if(name == "last-modified")
+    {
+        headers->lastModified = value;
+    }
+    else if(name == "cache-control")
+    {
+        std::transform(value.begin(),value.end(),value.begin(),::tolower);
+        
+        headers->noStore = value.find("no-store") != std::string::npos;
+        headers->noCache = value.find("no-cache") != std::string::npos;
+        
+        size_t maxAge = value.find("max-age=");
+        
+        if(maxAge != std::string::npos)
+            headers->maxAge = std::atoll(value.c_str() + maxAge + 8);
+    }
+    else if(name == "content-length")
+    {
+        headers->contentLength = std::atoll(value.c_str());
+    }
+    else if(name == "content-encoding")
+    {
+        std::transform(value.begin(),value.end(),value.begin(),::tolower);
+        
+        headers->contentEncoded = value != "identity";
+    }
     
     return totalBytes;
 }
@@ -82,6 +216,26 @@ struct WebSupplicant::PrivateImpl
 {
     CURL *curl;
     std::string data;
+    
+    WebCache *cache;
+    std::string url;
+    bool useCache;
+    bool cached;
+    bool validating;
+    WebCache::Entry entry;
+    
+    curl_slist *requestHeaders;
+    ResponseHeaders responseHeaders;
+    
+    Sink sink;
+    ResponseBody responseBody;
+    bool fromCache;
+    
+    long long wireBytes;
+    long long decodedBytes;
+    
+    int timeout;
+    CancellationToken cancellation;
 };
 
 
@@ -92,7 +246,30 @@ WebSupplicant::WebSupplicant() :
     
     
     if(m_impl)
+    {
+        m_impl->cache = nullptr;
+        m_impl->useCache = false;
+        m_impl->cached = false;
+        m_impl->validating = false;
+        m_impl->requestHeaders = nullptr;
+        m_impl->responseHeaders.body = &m_impl->data;
+        resetHeaders(m_impl->responseHeaders);
+        m_impl->responseBody.data = &m_impl->data;
+        m_impl->responseBody.sink = &m_impl->sink;
+        m_impl->responseBody.keep = true;
+        m_impl->responseBody.bytes = 0;
+        m_impl->fromCache = false;
+        m_impl->wireBytes = 0;
+        m_impl->decodedBytes = 0;
+        m_impl->timeout = 0;
+        
         m_impl->curl = ::curl_easy_init();
+        
+        // draw DNS, TLS sessions and connections from the process-wide pool
+        // rather than keeping our own
+        if(m_impl->curl  &&  WebServices::share())
+            ::curl_easy_setopt(m_impl->curl,CURLOPT_SHARE,(CURLSH *) WebServices::share());
+    }
 }
 
 
@@ -103,6 +280,9 @@ WebSupplicant::~WebSupplicant()
         if(m_impl->curl)
             ::curl_easy_cleanup(m_impl->curl);
         
+        if(m_impl->requestHeaders)
+            ::curl_slist_free_all(m_impl->requestHeaders);
+        
         delete m_impl;
     }
 }
@@ -110,44 +290,443 @@ WebSupplicant::~WebSupplicant()
 
 bool WebSupplicant::request(const std::string& url)
 {
+    if(!prepare(url))
+        return false;
+    
+    if(cached())
+        return finish(CURLE_OK,m_impl->data);
+    
+    
+    return finish(perform(),m_impl->data);
+}
+
+
+std::future<bool> WebSupplicant::requestAsync(const std::string& url)
+{
+    // run request() on another thread.  the future is ready once the request
+    // has finished, at which point data() holds the body.  this supplicant
+    // mustn't be touched until then, other than through its cancellation
+    // token
+    
+    return std::async(std::launch::async,[this,url]() { return request(url); });
+}
+
+
+bool WebSupplicant::connect(const std::string& url)
+{
+    // this function makes a request for the headers only, so the connection
+    // to the host is established and left in the shared pool without
+    // transferring a body
+    
+    if(!prepare(url,false))
+        return false;
+    
+    SetOptionAndReportError(m_impl->curl,CURLOPT_NOBODY,1L);
+    SetOptionAndReportError(m_impl->curl,CURLOPT_CONNECTTIMEOUT,5L);
+    
+    
+    return finish(perform(),m_impl->data);
+}
+
+
+int WebSupplicant::timeout() const
+{
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->timeout;
+}
+
+
+void WebSupplicant::setTimeout(int milliseconds)
+{
+    // the longest a request may take from start to finish.  zero means no
+    // limit
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->timeout = std::max(0,milliseconds);
+}
+
+
+CancellationToken WebSupplicant::cancellation() const
+{
+    if(!m_impl)
+        return CancellationToken();
+    
+    return m_impl->cancellation;
+}
+
+
+void WebSupplicant::setCancellation(const CancellationToken& cancellation)
+{
+    // once this token is cancelled, any request in progress is abandoned and
+    // any new one fails straight away
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->cancellation = cancellation;
+}
+
+
+const std::string& WebSupplicant::data() const
+{
+    // hand out a view of the body rather than a copy.  it stays valid until
+    // the next request
+    
+    static const std::string empty;
+    
+    if(!m_impl)
+        return empty;
+    
+    return m_impl->data;
+}
+
+
+std::string WebSupplicant::takeData()
+{
+    // move the body out to the caller, leaving this supplicant empty
+    
+    if(!m_impl)
+        return std::string();
+    
+    std::string data;
+    data.swap(m_impl->data);
+    
+    return data;
+}
+
+
+void WebSupplicant::setSink(const Sink& sink)
+{
+    // hand the body to a function as it arrives, instead of collecting it
+    // for data().  the sink is called with nullptr at the start of every
+    // request, since a transfer that's restarted starts again from scratch.
+    // a body from the cache is handed over in one go
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->sink = sink;
+}
+
+
+long long WebSupplicant::wireBytes() const
+{
+    // the size of the body as it came over the network for the last request,
+    // before any content encoding was undone.  this is zero if the body came
+    // from the cache
+    
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->wireBytes;
+}
+
+
+long long WebSupplicant::decodedBytes() const
+{
+    // the size of the body handed back for the last request
+    
+    if(!m_impl)
+        return 0;
+    
+    return m_impl->decodedBytes;
+}
+
+
+WebCache *WebSupplicant::cache() const
+{
+    if(!m_impl)
+        return nullptr;
+    
+    return m_impl->cache;
+}
+
+
+void WebSupplicant::setCache(WebCache *cache)
+{
+    // the cache is optional.  without one, every request goes to the network
+    
+    if(!m_impl)
+        return;
+    
+    m_impl->cache = cache;
+}
+
+
+bool WebSupplicant::prepare(const std::string& url,bool useCache)
+{
+    // this function configures the easy handle for a transfer without
+    // performing it.  the caller either performs it directly or hands the
+    // handle to a multi handle.  if the cache can satisfy the request outright
+    // then cached() is set and there's nothing to perform
+    
     if(!m_impl)
         return false;
     
     if(!m_impl->curl)
         return false;
     
+    if(m_impl->cancellation.cancelled())
+        return false;
+    
     
     m_impl->data.clear();
+    m_impl->url = url;
+    m_impl->useCache = useCache  &&  m_impl->cache  &&  m_impl->cache->valid();
+    m_impl->fromCache = false;
+    m_impl->cached = false;
+    m_impl->validating = false;
+    m_impl->wireBytes = 0;
+    m_impl->decodedBytes = 0;
+    resetHeaders(m_impl->responseHeaders);
+    
+    // with a sink, the body is only collected if the cache will need it
+    m_impl->responseBody.keep = !m_impl->sink  ||  m_impl->useCache;
+    m_impl->responseBody.bytes = 0;
+    m_impl->responseHeaders.body = m_impl->responseBody.keep ? &m_impl->data : nullptr;
+    
+    if(m_impl->sink)
+        m_impl->sink(nullptr,0);
+    
+    if(m_impl->requestHeaders)
+    {
+        ::curl_slist_free_all(m_impl->requestHeaders);
+        m_impl->requestHeaders = nullptr;
+    }
+    
+    
+    // if we have a fresh copy then we're done.  if we have a stale one, ask
+    // the server to only send the body if it changed
+    if(m_impl->useCache  &&  m_impl->cache->lookup(url,m_impl->entry))
+    {
+        if(m_impl->entry.expires > (long long) std::time(nullptr)  &&  m_impl->cache->load(url,m_impl->data))
+        {
+            m_impl->cache->countHit();
+            m_impl->cached = true;
+            m_impl->fromCache = true;
+            
+            return true;
+        }
+        
+        if(!m_impl->entry.etag.empty())
+            m_impl->requestHeaders = ::curl_slist_append(m_impl->requestHeaders,("If-None-Match: " + m_impl->entry.etag).c_str());
+        
+        if(!m_impl->entry.lastModified.empty())
+            m_impl->requestHeaders = ::curl_slist_append(m_impl->requestHeaders,("If-Modified-Since: " + m_impl->entry.lastModified).c_str());
+        
+        m_impl->validating = m_impl->requestHeaders != nullptr;
+    }
     
     
     SetOptionAndReportError(m_impl->curl,CURLOPT_URL,url.c_str());
+    SetOptionAndReportError(m_impl->curl,CURLOPT_HTTPGET,1L);
+    SetOptionAndReportError(m_impl->curl,CURLOPT_CONNECTTIMEOUT,0L);
+    SetOptionAndReportError(m_impl->curl,CURLOPT_TIMEOUT_MS,(long) m_impl->timeout);
     SetOptionAndReportError(m_impl->curl,CURLOPT_WRITEFUNCTION,writeCallback);
-    SetOptionAndReportError(m_impl->curl,CURLOPT_WRITEDATA,(void *) &m_impl->data);
+    SetOptionAndReportError(m_impl->curl,CURLOPT_WRITEDATA,(void *) &m_impl->responseBody);
+    SetOptionAndReportError(m_impl->curl,CURLOPT_HEADERFUNCTION,headerCallback);
+    SetOptionAndReportError(m_impl->curl,CURLOPT_HEADERDATA,(void *) &m_impl->responseHeaders);
+    SetOptionAndReportError(m_impl->curl,CURLOPT_HTTPHEADER,m_impl->requestHeaders);
     SetOptionAndReportError(m_impl->curl,CURLOPT_USERAGENT,"libcurl-agent/1.0");
 /*  SetOptionAndReportError(m_impl->curl,CURLOPT_FOLLOWLOCATION,true);*/
     SetOptionAndReportError(m_impl->curl,CURLOPT_SSL_VERIFYPEER,false);
     SetOptionAndReportError(m_impl->curl,CURLOPT_SSL_VERIFYHOST,false);
+    
+    // negotiate HTTP/2 where the server supports it, and wait for an existing
+    // connection to multiplex over instead of opening a new one
+    SetOptionAndReportError(m_impl->curl,CURLOPT_HTTP_VERSION,(long) CURL_HTTP_VERSION_2TLS);
+    SetOptionAndReportError(m_impl->curl,CURLOPT_PIPEWAIT,1L);
+    
+    // offer every content encoding curl was built with.  the body is inflated
+    // as it streams in, so the write callback only ever sees decoded bytes
+    SetOptionAndReportError(m_impl->curl,CURLOPT_ACCEPT_ENCODING,"");
+    
+    return true;
+}
 
+
+bool WebSupplicant::finish(int result,std::string& data)
+{
+    // this function is called once a transfer has completed, either by
+    // request() or by the dispatcher that performed it.  the body is swapped
+    // out to the caller rather than copied, and whatever buffer the caller
+    // passed in is kept for the next transfer to fill
+    
+    if(!m_impl)
+        return false;
+    
+    if(result == CURLE_OK  &&  !m_impl->cached)
+    {
+        curl_off_t wireBytes = 0;
+        
+        if(::curl_easy_getinfo(m_impl->curl,CURLINFO_SIZE_DOWNLOAD_T,&wireBytes) == CURLE_OK)
+            m_impl->wireBytes = (long long) wireBytes;
+    }
+    
+    if(result == CURLE_OK  &&  m_impl->useCache  &&  !m_impl->cached  &&  !updateCache())
+        result = CURLE_READ_ERROR;
     
-    CURLcode result = ::curl_easy_perform(m_impl->curl);
+    m_impl->decodedBytes = m_impl->fromCache ? (long long) m_impl->data.size() : m_impl->responseBody.bytes;
+    
+    if(result == CURLE_OK  &&  m_impl->fromCache  &&  m_impl->sink  &&  !m_impl->sink(m_impl->data.data(),m_impl->data.size()))
+        result = CURLE_WRITE_ERROR;
+    
+    if(&data != &m_impl->data)
+    {
+        data.clear();
+        data.swap(m_impl->data);
+    }
+    
+    
+    // a cancelled request isn't an error worth reporting
+    if(result != CURLE_OK  &&  m_impl->cancellation.cancelled())
+        return false;
     
     if(result != CURLE_OK)
     {
-        std::cerr << "WebSupplicant::request:  error performing request:  "
-                  << ::curl_easy_strerror(result)
+        std::cerr << "WebSupplicant::finish:  error performing request:  "
+                  << ::curl_easy_strerror((CURLcode) result)
                   << std::endl;
         
         return false;
     }
+    
+    return true;
+}
+
+
+bool WebSupplicant::cached() const
+{
+    if(!m_impl)
+        return false;
+    
+    return m_impl->cached;
+}
 
+
+bool WebSupplicant::updateCache()
+{
+    // a 304 means our stale copy is still good, so we swap it in for the empty
+    // body and push out its expiry.  a 200 replaces whatever we had.  if the
+    // stale copy can't be read back, the entry is dropped so the next request
+    // goes out without validators rather than getting the same 304 forever
+    
+    long status = 0;
+    ::curl_easy_getinfo(m_impl->curl,CURLINFO_RESPONSE_CODE,&status);
+    
+    const ResponseHeaders& headers = m_impl->responseHeaders;
+    long long expires = 0;
+    
+    if(headers.maxAge > 0  &&  !headers.noCache)
+        expires = (long long) std::time(nullptr) + headers.maxAge;
+    
+    
+    if(status == 304  &&  m_impl->validating)
+    {
+        if(!m_impl->cache->load(m_impl->url,m_impl->data))
+        {
+            std::cerr << "WebSupplicant::updateCache:  error loading cached body for '" << m_impl->url << "'" << std::endl;
+            
+            m_impl->cache->remove(m_impl->url);
+            m_impl->data.clear();
+            
+            return false;
+        }
+        
+        m_impl->entry.expires = expires;
+        
+        if(!headers.etag.empty())
+            m_impl->entry.etag = headers.etag;
+        
+        if(!headers.lastModified.empty())
+            m_impl->entry.lastModified = headers.lastModified;
+        
+        m_impl->cache->refresh(m_impl->url,m_impl->entry);
+        m_impl->cache->countRevalidation();
+        m_impl->fromCache = true;
+    }
+    else if(status == 200)
+    {
+        m_impl->cache->countMiss();
+        
+        if(headers.noStore)
+            return true;
+        
+        WebCache::Entry entry;
+        entry.etag = headers.etag;
+        entry.lastModified = headers.lastModified;
+        entry.expires = expires;
+        
+        m_impl->cache->store(m_impl->url,entry,m_impl->data);
+    }
+    
     return true;
 }
 
 
-std::string WebSupplicant::data() const
+int WebSupplicant::perform()
+{
+    // run the transfer on a multi handle of its own rather than with
+    // curl_easy_perform, so we get control back every few milliseconds to
+    // see if it's been cancelled
+    
+    CURLM *multi = ::curl_multi_init();
+    
+    if(!multi)
+        return CURLE_OUT_OF_MEMORY;
+    
+    if(::curl_multi_add_handle(multi,m_impl->curl) != CURLM_OK)
+    {
+        ::curl_multi_cleanup(multi);
+        return CURLE_FAILED_INIT;
+    }
+    
+    
+    CURLcode result = CURLE_OK;
+    bool done = false;
+    
+    while(!done)
+    {
+        if(m_impl->cancellation.cancelled())
+        {
+            result = CURLE_ABORTED_BY_CALLBACK;
+            break;
+        }
+        
+        int running = 0;
+        ::curl_multi_perform(multi,&running);
+        
+        CURLMsg *message;
+        int remaining;
+        
+        while((message = ::curl_multi_info_read(multi,&remaining)) != nullptr)
+        {
+            if(message->msg == CURLMSG_DONE)
+            {
+                result = message->data.result;
+                done = true;
+            }
+        }
+        
+        if(!done)
+            ::curl_multi_poll(multi,nullptr,0,20,nullptr);
+    }
+    
+    ::curl_multi_remove_handle(multi,m_impl->curl);
+    ::curl_multi_cleanup(multi);
+    
+    return result;
+}
+
+
+void *WebSupplicant::handle() const
 {
     if(!m_impl)
-        return std::string();
+        return nullptr;
     
-    return m_impl->data;
+    return m_impl->curl;
 }
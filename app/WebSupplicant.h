@@ -1,19 +1,54 @@
 #pragma once
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <string>
+#include "CancellationToken.h"
 
 
+class WebCache;
+
 class WebSupplicant
 {
+    public:
+        typedef std::function<bool(const char *data,size_t size)> Sink;
+        
     public:
         WebSupplicant();
         ~WebSupplicant();
         
         bool request(const std::string& url);
+        std::future<bool> requestAsync(const std::string& url);
+        bool connect(const std::string& url);
+        
+        int timeout() const;
+        void setTimeout(int milliseconds);
+        
+        CancellationToken cancellation() const;
+        void setCancellation(const CancellationToken& cancellation);
+        
+        const std::string& data() const;
+        std::string takeData();
         
-        std::string data() const;
+        void setSink(const Sink& sink);
+        
+        long long wireBytes() const;
+        long long decodedBytes() const;
+        
+        WebCache *cache() const;
+        void setCache(WebCache *cache);
         
     private:
+        friend class WebDispatcher;
+        
+        bool prepare(const std::string& url,bool useCache = true);
+        bool finish(int result,std::string& data);
+        bool cached() const;
+        bool updateCache();
+        int perform();
+        void *handle() const;
+        
+        
         struct PrivateImpl;
         PrivateImpl *m_impl;
 };
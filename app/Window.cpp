@@ -2,6 +2,7 @@
 #include "glad/glad.h"
 #define GLFW_INCLUDE_NONE
 #include "GLFW/glfw3.h"
+#include "GraphicsCache.h"
 #include "Window.h"
 #include "WindowServices.h"
 
@@ -51,6 +52,7 @@ static void APIENTRY debugMessageCallback(GLenum source,GLenum type,unsigned int
 struct Window::PrivateImpl
 {
     GLFWwindow *windowHandle;
+    GraphicsCache graphicsCache;
 };
 
 
@@ -124,6 +126,11 @@ bool Window::create(int width,int height,const std::string& title)
     ::glDebugMessageCallback(debugMessageCallback,nullptr);
     ::glDebugMessageControl(GL_DONT_CARE,GL_DONT_CARE,GL_DONT_CARE,0,nullptr,GL_TRUE);
     
+    
+    // the shaders and geometry everything draws with are kept for the
+    // context, and go along with it
+    m_impl->graphicsCache.makeCurrent();
+    
     return onCreate();
 }
 
@@ -139,6 +146,8 @@ void Window::destroy()
     
     onDestroy();
     
+    m_impl->graphicsCache.destroy();
+    
     ::glfwDestroyWindow(m_impl->windowHandle);
     m_impl->windowHandle = nullptr;
 }
@@ -167,6 +176,7 @@ void Window::render()
     
     
     ::glfwMakeContextCurrent(m_impl->windowHandle);
+    m_impl->graphicsCache.makeCurrent();
     
 
     onRender();
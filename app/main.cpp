@@ -1,12 +1,32 @@
+#include <algorithm>
+#include <cstdlib>
 #include <string>
 #include "DisneyWindow.h"
 
 
+static void setImageDecoder(const std::string& name)
+{
+    // decode every format the named backend can read with it
+    
+    for(int backend = 0;backend < ImageDecoder::BackendCount;++backend)
+    {
+        if(name != ImageDecoder::name((ImageDecoder::Backend) backend))
+            continue;
+        
+        for(int format = 0;format < ImageDecoder::FormatCount;++format)
+        {
+            if(ImageDecoder::supports((ImageDecoder::Backend) backend,(ImageDecoder::Format) format))
+                Image::setDecoder((ImageDecoder::Format) format,(ImageDecoder::Backend) backend);
+        }
+    }
+}
+
+
 /*
  *  Initializes GLFW, creates a window, and pumps the render() function.
  */
 
-int main(int /*argc*/,char **argv)
+int main(int argc,char **argv)
 {
     // capture the path to this binary
     
@@ -24,6 +44,57 @@ int main(int /*argc*/,char **argv)
     
     DisneyWindow window(binaryPath);
     
+    
+    // --lazy only loads the rows and tiles near the visible grid, and --sized
+    // asks for tile art at the size it's drawn.  --full-decode decodes tile
+    // art at its full size, rather than the size it's drawn.  --webp asks for
+    // tile art as WebP.  --image-decoder=<backend> decodes every format it can
+    // with that backend:  stb, ffmpeg, turbojpeg, libpng or libwebp.
+    // --parser=<backend> picks how the catalog documents are parsed:  dom,
+    // stream or simdjson.  --no-snapshot always starts from the network, and
+    // doesn't save the catalog on the way out.  --texture-cache keeps tile
+    // art on disk decoded, rather than decoding it again every launch.
+    // --compress-textures block compresses tile art for the GPU.
+    // --refresh=<seconds> fetches the catalog again that often while running,
+    // and updates the grid with whatever changed.  --image-budget=<megabytes>
+    // and --texture-budget=<megabytes> cap the tile art kept decoded and on
+    // the GPU, 0 for no cap.  --encoded-cache=<megabytes> keeps that much tile
+    // art as downloaded, and decodes it only as it nears the screen
+    
+    for(int index = 1;index < argc;++index)
+    {
+        if(std::string(argv[index]) == "--lazy")
+            window.setLazyLoading(true);
+        else if(std::string(argv[index]) == "--sized")
+            window.setSizedImages(true);
+        else if(std::string(argv[index]) == "--full-decode")
+            window.setScaledDecoding(false);
+        else if(std::string(argv[index]) == "--webp")
+            window.setWebpImages(true);
+        else if(std::string(argv[index]).compare(0,16,"--image-decoder=") == 0)
+            setImageDecoder(argv[index] + 16);
+        else if(std::string(argv[index]) == "--parser=dom")
+            window.setParserBackend(CatalogParser::BackendDom);
+        else if(std::string(argv[index]) == "--parser=stream")
+            window.setParserBackend(CatalogParser::BackendStream);
+        else if(std::string(argv[index]) == "--parser=simdjson")
+            window.setParserBackend(CatalogParser::BackendSimdjson);
+        else if(std::string(argv[index]) == "--no-snapshot")
+            window.setSnapshots(false);
+        else if(std::string(argv[index]) == "--texture-cache")
+            window.setTextureCaching(true);
+        else if(std::string(argv[index]) == "--compress-textures")
+            window.setCompressedTextures(true);
+        else if(std::string(argv[index]).compare(0,10,"--refresh=") == 0)
+            window.setRefreshInterval(std::atof(argv[index] + 10));
+        else if(std::string(argv[index]).compare(0,15,"--image-budget=") == 0)
+            window.setImageBudget((size_t) (std::max(0.0,std::atof(argv[index] + 15)) * 1048576));
+        else if(std::string(argv[index]).compare(0,17,"--texture-budget=") == 0)
+            window.setTextureBudget((size_t) (std::max(0.0,std::atof(argv[index] + 17)) * 1048576));
+        else if(std::string(argv[index]).compare(0,16,"--encoded-cache=") == 0)
+            window.setEncodedBudget((size_t) (std::max(0.0,std::atof(argv[index] + 16)) * 1048576));
+    }
+    
     if(!window.create(1280,720,"Disney+ Project"))
         return 1;
     
@@ -0,0 +1,361 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "CatalogParser.h"
+#include "Fixture.h"
+
+
+/*
+ *  Times each catalog parser backend over the same documents, and checks they
+ *  all agree on what's in them.
+ *
+ *  catalogbench [--iterations=<count>] [--chunk=<bytes>] [home.json] [set.json...]
+ *
+ *  the first document is parsed as a home document and the rest as set
+ *  documents.  without any, a large synthetic home and set are generated in
+ *  the shape the service returns.
+ *
+ *  alongside the times, each backend reports how many times it went to the
+ *  heap per document, counted by replacing the global operator new.
+ */
+
+
+static std::atomic<long long> heapAllocations(0);
+
+
+void *operator new(size_t size)
+{
+    ++heapAllocations;
+    
+    if(void *data = std::malloc(size ? size : 1))
+        return data;
+    
+    throw std::bad_alloc();
+}
+
+
+void operator delete(void *data) noexcept
+{
+    std::free(data);
+}
+
+
+struct CatalogFixture : Fixture
+{
+    CatalogParser::Document document;
+};
+
+
+static std::string hashText(int index,int salt)
+{
+    // 64 hex digits standing in for the content hashes the image and video
+    // urls are made from
+    
+    static const char *digits = "0123456789ABCDEF";
+    
+    uint32_t state = (uint32_t) index * 2654435761u + (uint32_t) salt * 40503u + 1;
+    std::string text(64,'0');
+    
+    for(char& c : text)
+    {
+        state = state * 1664525u + 1013904223u;
+        c = digits[state >> 28];
+    }
+    
+    return text;
+}
+
+
+static std::string tileJson(int index)
+{
+    // a tile with about as much around it as the real ones have, most of
+    // which the parsers should skip
+    
+    static const char *kinds[] = {"program","series","collection"};
+    static const char *ratings[] = {"G","PG","PG-13","TV-Y7","TV-14"};
+    
+    const char *kind = kinds[index % 3];
+    std::ostringstream json;
+    
+    json << "{\"contentId\":\"" << std::hex << index * 2654435761u << std::dec << "\","
+         << "\"callToAction\":null,\"currentAvailability\":{\"region\":\"US\",\"kidsMode\":" << (index % 4 == 0 ? "true" : "false") << "},"
+         << "\"image\":{\"tile\":{"
+         <<     "\"0.71\":{\"" << kind << "\":{\"default\":{\"masterId\":\"m" << index << "\",\"masterWidth\":1000,\"masterHeight\":1400,\"url\":\"https://prod-ripcut-delivery.disney-plus.net/v1/variant/disney/" << hashText(index,1) << "/scale?format=jpeg&quality=90&scalingAlgorithm=lanczos3&width=500\"}}},"
+         <<     "\"1.78\":{\"" << kind << "\":{\"default\":{\"masterId\":\"m" << index << "\",\"masterWidth\":1920,\"masterHeight\":1080,\"url\":\"https://prod-ripcut-delivery.disney-plus.net/v1/variant/disney/" << hashText(index,2) << "/scale?format=jpeg&quality=90&scalingAlgorithm=lanczos3&width=500\"}}}},"
+         << "\"background\":{\"1.78\":{\"" << kind << "\":{\"default\":{\"masterId\":\"b" << index << "\",\"masterWidth\":3840,\"masterHeight\":2160,\"url\":\"https://prod-ripcut-delivery.disney-plus.net/v1/variant/disney/" << hashText(index,3) << "/scale\"}}}}},"
+         << "\"ratings\":[{\"advisories\":[],\"description\":null,\"system\":\"MPAA\",\"value\":\"" << ratings[index % 5] << "\"}],"
+         << "\"releases\":[{\"releaseDate\":" << (index % 7 == 0 ? std::string("null") : "\"19" + std::to_string(50 + index % 50) + "-0" + std::to_string(1 + index % 9) + "-1" + std::to_string(index % 10) + "\"") << ",\"releaseType\":\"original\",\"releaseYear\":" << 1950 + index % 50 << ",\"territory\":null}],"
+         << "\"tags\":[{\"displayName\":null,\"type\":\"disneyPlusVideoId\",\"value\":\"" << index << "\"},{\"displayName\":null,\"type\":\"disneyPlusContentId\",\"value\":\"c" << index << "\"}],"
+         << "\"text\":{\"title\":{\"full\":{\"" << kind << "\":{\"default\":{\"content\":\"Title \\u00e9 \\\"" << index << "\\\" \\ud83c\\udfac\",\"language\":\"en\",\"sourceEntity\":\"" << kind << "\"}}},"
+         <<     "\"slug\":{\"" << kind << "\":{\"default\":{\"content\":\"title-" << index << "\",\"language\":\"en\",\"sourceEntity\":\"" << kind << "\"}}}}},"
+         << "\"type\":\"DmcVideo\","
+         << "\"videoArt\":[";
+    
+    if(index % 2 == 0)
+        json << "{\"mediaMetadata\":{\"urls\":[{\"url\":\"https://vod-bgc-na-east-1.media.dssott.com/bgui/ps01/disney/bgui/" << hashText(index,4) << ".mp4\"}]},\"purpose\":\"brand_video\"}";
+    
+    json << "],\"videoId\":\"v" << index << "\",\"duration\":" << 1000.5 + index << "}";
+    
+    return json.str();
+}
+
+
+static std::string setJson(int index,int tiles,bool reference)
+{
+    std::ostringstream json;
+    
+    json << "{\"contentClass\":\"editorial\",\"experimentToken\":null,\"setId\":\"s" << index << "\","
+         << "\"text\":{\"title\":{\"full\":{\"set\":{\"default\":{\"content\":\"Row " << index << "\",\"language\":\"en\",\"sourceEntity\":\"set\"}}}}},";
+    
+    if(reference)
+    {
+        json << "\"refId\":\"ref" << index << "\",\"refIdType\":\"setId\",\"refType\":\"CuratedSet\",\"type\":\"SetRef\"}";
+        return json.str();
+    }
+    
+    json << "\"items\":[";
+    
+    // rows share titles, the way the real ones do
+    for(int tile = 0;tile < tiles;++tile)
+        json << (tile ? "," : "") << tileJson((index * 7 + tile * 13) % 500);
+    
+    json << "],\"meta\":{\"hits\":" << tiles << ",\"offset\":0,\"page_size\":" << tiles << "},\"type\":\"CuratedSet\"}";
+    
+    return json.str();
+}
+
+
+static std::vector<CatalogFixture> syntheticFixtures()
+{
+    // a home with 60 rows, a third of them references, a set of 300 tiles, and
+    // a set document holding two sets out of key order, drawn from 500 titles
+    
+    std::vector<CatalogFixture> fixtures(3);
+    
+    std::ostringstream home;
+    home << "{\"data\":{\"StandardCollection\":{\"callToAction\":null,\"collectionGroup\":{\"key\":\"home\"},\"containers\":[";
+    
+    for(int row = 0;row < 60;++row)
+        home << (row ? "," : "") << "{\"set\":" << setJson(row,30,row % 3 == 1) << ",\"style\":\"ContentContainer\",\"type\":\"ShelfContainer\"}";
+    
+    home << "],\"type\":\"StandardCollection\"}}}";
+    
+    fixtures[0].name = "synthetic home";
+    fixtures[0].document = CatalogParser::HomeDocument;
+    fixtures[0].data = home.str();
+    
+    fixtures[1].name = "synthetic set";
+    fixtures[1].document = CatalogParser::SetDocument;
+    fixtures[1].data = "{\"data\":{\"CuratedSet\":" + setJson(1000,300,false) + "}}";
+    
+    fixtures[2].name = "synthetic set, two sets";
+    fixtures[2].document = CatalogParser::SetDocument;
+    fixtures[2].data = "{\"data\":{\"PersonalizedCuratedSet\":" + setJson(1001,20,false) + ",\"CuratedSet\":" + setJson(1002,20,false) + "}}";
+    
+    return fixtures;
+}
+
+
+static bool sameTileSets(const std::vector<TileSet>& a,const TileTable& aTiles,const std::vector<TileSet>& b,const TileTable& bTiles)
+{
+    if(a.size() != b.size())
+        return false;
+    
+    for(size_t set = 0;set < a.size();++set)
+    {
+        if(a[set].name != b[set].name  ||  a[set].refId != b[set].refId  ||
+           a[set].loaded != b[set].loaded  ||  a[set].tiles.size() != b[set].tiles.size())
+            return false;
+        
+        for(size_t tile = 0;tile < a[set].tiles.size();++tile)
+        {
+            TileId x = a[set].tiles[tile];
+            TileId y = b[set].tiles[tile];
+            
+            if(aTiles.name(x) != bTiles.name(y)  ||  aTiles.rating(x) != bTiles.rating(y)  ||
+               aTiles.releaseDate(x) != bTiles.releaseDate(y)  ||
+               aTiles.urlText(aTiles.url(x)) != bTiles.urlText(bTiles.url(y))  ||
+               aTiles.urlText(aTiles.videoUrl(x)) != bTiles.urlText(bTiles.videoUrl(y)))
+                return false;
+        }
+    }
+    
+    return true;
+}
+
+
+static size_t stringMemory(const std::string& text)
+{
+    // what a std::string costs, counting its heap buffer if it's too long for
+    // the small string buffer most libraries have
+    
+    return sizeof(std::string) + (text.size() >= 16 ? text.capacity() + 1 : 0);
+}
+
+
+static size_t structMemory(const std::vector<TileSet>& tileSets,const TileTable& tiles)
+{
+    // what the tiles would take as one struct of five strings each, the way
+    // they were stored before the tile table
+    
+    size_t bytes = 0;
+    
+    for(const TileSet& tileSet : tileSets)
+    {
+        for(TileId id : tileSet.tiles)
+        {
+            bytes += sizeof(std::shared_ptr<void>) + sizeof(int) +
+                     stringMemory(tiles.name(id)) + stringMemory(tiles.releaseDate(id)) + stringMemory(tiles.rating(id)) +
+                     stringMemory(tiles.urlText(tiles.url(id))) + stringMemory(tiles.urlText(tiles.videoUrl(id)));
+        }
+    }
+    
+    return bytes;
+}
+
+
+static bool parse(CatalogParser& parser,const std::string& json,size_t chunk,std::vector<TileSet>& tileSets,TileTable& tiles)
+{
+    // feed the document in chunks, the way it arrives off the network
+    
+    parser.reset();
+    
+    for(size_t offset = 0;offset < json.size();offset += chunk)
+    {
+        if(!parser.feed(json.data() + offset,std::min(chunk,json.size() - offset)))
+            return false;
+    }
+    
+    if(!parser.finish())
+        return false;
+    
+    tileSets = parser.takeTileSets(tiles);
+    return true;
+}
+
+
+int main(int argc,char **argv)
+{
+    int iterations = 50;
+    size_t chunk = 16384;
+    std::vector<std::string> paths;
+    
+    for(int index = 1;index < argc;++index)
+    {
+        std::string arg(argv[index]);
+        
+        if(arg.compare(0,13,"--iterations=") == 0)
+            iterations = std::max(1,atoi(arg.c_str() + 13));
+        else if(arg.compare(0,8,"--chunk=") == 0)
+            chunk = (size_t) std::max(1,atoi(arg.c_str() + 8));
+        else
+            paths.push_back(arg);
+    }
+    
+    
+    std::vector<CatalogFixture> fixtures;
+    
+    if(paths.empty())
+    {
+        fixtures = syntheticFixtures();
+    }
+    else
+    {
+        if(!readFixtures("catalogbench",paths,fixtures))
+            return 1;
+        
+        for(size_t index = 0;index < fixtures.size();++index)
+            fixtures[index].document = index == 0 ? CatalogParser::HomeDocument : CatalogParser::SetDocument;
+    }
+    
+    
+    const CatalogParser::Backend backends[] = {CatalogParser::BackendDom,CatalogParser::BackendStream,CatalogParser::BackendSimdjson};
+    bool agree = true;
+    
+    for(const CatalogFixture& fixture : fixtures)
+    {
+        std::cout << fixture.name << ":  " << fixture.data.size() << " bytes, " << iterations << " iterations, " << chunk << " byte chunks" << std::endl;
+        
+        std::vector<TileSet> reference;
+        TileTable referenceTiles;
+        bool haveReference = false;
+        
+        for(CatalogParser::Backend backend : backends)
+        {
+            if(!CatalogParser::available(backend))
+            {
+                std::cout << "    " << std::left << std::setw(10) << CatalogParser::name(backend) << "not built in" << std::endl;
+                continue;
+            }
+            
+            
+            std::shared_ptr<CatalogParser> parser = CatalogParser::create(backend,fixture.document);
+            std::vector<TileSet> tileSets;
+            TileTable tiles;
+            std::vector<double> times;
+            long long allocations = 0;
+            bool ok = true;
+            
+            times.reserve(iterations);
+            
+            for(int iteration = 0;iteration < iterations  &&  ok;++iteration)
+            {
+                long long startAllocations = heapAllocations;
+                auto start = std::chrono::steady_clock::now();
+                
+                ok = parse(*parser,fixture.data,chunk,tileSets,tiles);
+                
+                times.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count());
+                allocations += heapAllocations - startAllocations;
+            }
+            
+            if(!ok)
+            {
+                std::cout << "    " << std::left << std::setw(10) << CatalogParser::name(backend) << "failed to parse" << std::endl;
+                agree = false;
+                continue;
+            }
+            
+            
+            std::sort(times.begin(),times.end());
+            
+            double median = times[times.size() / 2];
+            size_t tileCount = 0;
+            
+            for(const TileSet& tileSet : tileSets)
+                tileCount += tileSet.tiles.size();
+            
+            bool same = !haveReference  ||  sameTileSets(reference,referenceTiles,tileSets,tiles);
+            agree = agree  &&  same;
+            
+            std::cout << "    " << std::left << std::setw(10) << CatalogParser::name(backend)
+                      << std::right << std::fixed << std::setprecision(3)
+                      << std::setw(10) << times.front() << " ms min"
+                      << std::setw(10) << median << " ms median"
+                      << std::setprecision(1) << std::setw(10) << fixture.data.size() / median / 1000.0 << " MB/s"
+                      << std::setw(10) << allocations / (long long) times.size() << " allocs"
+                      << "    " << tileSets.size() << " rows, " << tileCount << " tiles"
+                      << (same ? "" : "    MISMATCH") << std::endl;
+            
+            if(!haveReference)
+            {
+                std::cout << "    " << tiles.size() << " tiles take " << tiles.memoryUsage() << " bytes in the tile table, against "
+                          << structMemory(tileSets,tiles) << " bytes as strings" << std::endl;
+                
+                reference.swap(tileSets);
+                referenceTiles.swap(tiles);
+                haveReference = true;
+            }
+        }
+    }
+    
+    return agree ? 0 : 1;
+}
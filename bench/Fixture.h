@@ -0,0 +1,56 @@
+#pragma once
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+// what the benchmarks run over:  files named on the command line, or, without
+// any, fixtures each benchmark generates in the shape the service returns
+
+
+struct Fixture
+{
+    std::string name;
+    std::string data;
+};
+
+
+inline std::string readFile(const std::string& path)
+{
+    std::ifstream file(path.c_str(),std::ios::binary);
+    
+    if(!file)
+        return std::string();
+    
+    std::stringstream stream;
+    stream << file.rdbuf();
+    
+    return stream.str();
+}
+
+
+template<typename T>
+inline bool readFixtures(const char *program,const std::vector<std::string>& paths,std::vector<T>& fixtures)
+{
+    // read each file into a fixture named after it.  this returns false if
+    // one of them can't be read, or is empty
+    
+    for(const std::string& path : paths)
+    {
+        T fixture;
+        fixture.name = path;
+        fixture.data = readFile(path);
+        
+        if(fixture.data.empty())
+        {
+            std::cerr << program << ":  error reading '" << path << "'" << std::endl;
+            return false;
+        }
+        
+        fixtures.push_back(fixture);
+    }
+    
+    return true;
+}
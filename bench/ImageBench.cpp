@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Fixture.h"
+#include "Image.h"
+#include "ImageDecoder.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+
+/*
+ *  Times each image decoder backend over the same images, in full and at the
+ *  width tiles are drawn, and checks they agree on the size of what comes out.
+ *
+ *  imagebench [--iterations=<count>] [--width=<pixels>] [image...]
+ *
+ *  the images are the tile art as it comes from the CDN, such as the bodies
+ *  kept by the web cache.  without any, a set of JPEG and PNG tiles is
+ *  generated in the shapes the CDN serves.
+ *
+ *  scaled decodes include taking off whatever the backend leaves over the
+ *  width, as Image::loadScaled does.
+ */
+
+
+static void appendData(void *context,void *data,int size)
+{
+    ((std::string *) context)->append((const char *) data,size);
+}
+
+
+static std::string syntheticImage(int index,int width,int height,int bytes,bool png)
+{
+    // smooth gradients under some texture and a few hard edges, which
+    // compresses about the way poster art does
+    
+    std::vector<unsigned char> pixels(width * height * bytes);
+    uint32_t state = (uint32_t) index * 2654435761u + 1;
+    
+    for(int y = 0;y < height;++y)
+    {
+        for(int x = 0;x < width;++x)
+        {
+            state = state * 1664525u + 1013904223u;
+            
+            int noise = (int) (state >> 28) - 8;
+            bool edge = ((x / 37 + y / 53 + index) % 5) == 0;
+            unsigned char *pixel = &pixels[(y * width + x) * bytes];
+            
+            for(int channel = 0;channel < std::min(bytes,3);++channel)
+            {
+                int value = (x * (channel + 1) * 255 / width + y * (3 - channel) * 255 / height + index * 40) / 2 + noise + (edge ? 60 : 0);
+                pixel[channel] = (unsigned char) std::max(0,std::min(255,value));
+            }
+            
+            if(bytes == 4)
+                pixel[3] = edge ? 255 : (unsigned char) (y * 255 / height);
+        }
+    }
+    
+    
+    std::string data;
+    
+    if(png)
+        ::stbi_write_png_to_func(appendData,&data,width,height,bytes,pixels.data(),width * bytes);
+    else
+        ::stbi_write_jpg_to_func(appendData,&data,width,height,bytes,pixels.data(),90);
+    
+    return data;
+}
+
+
+static std::vector<Fixture> syntheticFixtures()
+{
+    // 24 posters and landscape tiles at the 500 pixels wide we ask the CDN
+    // for, and 4 title treatments with alpha
+    
+    std::vector<Fixture> fixtures;
+    
+    for(int index = 0;index < 28;++index)
+    {
+        Fixture fixture;
+        
+        if(index < 12)
+        {
+            fixture.name = "synthetic poster " + std::to_string(index);
+            fixture.data = syntheticImage(index,500,700,3,false);
+        }
+        else if(index < 24)
+        {
+            fixture.name = "synthetic landscape " + std::to_string(index);
+            fixture.data = syntheticImage(index,500,281,3,false);
+        }
+        else
+        {
+            fixture.name = "synthetic title " + std::to_string(index);
+            fixture.data = syntheticImage(index,500,281,4,true);
+        }
+        
+        fixtures.push_back(fixture);
+    }
+    
+    return fixtures;
+}
+
+
+static bool sameSizes(const std::vector<int>& a,const std::vector<int>& b)
+{
+    // scaled heights can round a pixel apart, depending on the size a
+    // backend decoded to before it was taken down to the width
+    
+    if(a.size() != b.size())
+        return false;
+    
+    for(size_t index = 0;index < a.size();++index)
+    {
+        if(std::abs(a[index] - b[index]) > 1)
+            return false;
+    }
+    
+    return true;
+}
+
+
+static bool decode(const ImageDecoder& decoder,const Fixture& fixture,int width,Image& image)
+{
+    image.destroy();
+    
+    if(!decoder.decode((const unsigned char *) fixture.data.data(),(int) fixture.data.size(),width,image))
+        return false;
+    
+    if(width > 0  &&  image.width() > width)
+        return image.resize(width,std::max(1,(int) std::lround((double) image.height() * width / image.width())));
+    
+    return true;
+}
+
+
+int main(int argc,char **argv)
+{
+    int iterations = 10;
+    int width = 240;
+    std::vector<std::string> paths;
+    
+    for(int index = 1;index < argc;++index)
+    {
+        std::string arg(argv[index]);
+        
+        if(arg.compare(0,13,"--iterations=") == 0)
+            iterations = std::max(1,atoi(arg.c_str() + 13));
+        else if(arg.compare(0,8,"--width=") == 0)
+            width = std::max(1,atoi(arg.c_str() + 8));
+        else
+            paths.push_back(arg);
+    }
+    
+    
+    std::vector<Fixture> fixtures;
+    
+    if(paths.empty())
+        fixtures = syntheticFixtures();
+    else if(!readFixtures("imagebench",paths,fixtures))
+        return 1;
+    
+    
+    bool agree = true;
+    
+    for(int formatIndex = 0;formatIndex < ImageDecoder::FormatCount;++formatIndex)
+    {
+        ImageDecoder::Format format = (ImageDecoder::Format) formatIndex;
+        std::vector<const Fixture *> images;
+        size_t bytes = 0;
+        
+        for(const Fixture& fixture : fixtures)
+        {
+            if(ImageDecoder::format((const unsigned char *) fixture.data.data(),(int) fixture.data.size()) == format)
+            {
+                images.push_back(&fixture);
+                bytes += fixture.data.size();
+            }
+        }
+        
+        if(images.empty())
+            continue;
+        
+        std::cout << ImageDecoder::name(format) << ":  " << images.size() << " images, " << bytes << " bytes, "
+                  << iterations << " iterations, scaled to " << width << " pixels wide" << std::endl;
+        
+        
+        // the sizes the first backend decodes to, in full and scaled
+        std::vector<int> referenceSizes;
+        
+        for(int backendIndex = 0;backendIndex < ImageDecoder::BackendCount;++backendIndex)
+        {
+            ImageDecoder::Backend backend = (ImageDecoder::Backend) backendIndex;
+            
+            if(!ImageDecoder::supports(backend,format))
+                continue;
+            
+            if(!ImageDecoder::available(backend))
+            {
+                std::cout << "    " << std::left << std::setw(12) << ImageDecoder::name(backend) << "not built in" << std::endl;
+                continue;
+            }
+            
+            const ImageDecoder *decoder = ImageDecoder::get(backend);
+            std::vector<int> sizes;
+            bool ok = true;
+            
+            for(int scaled = 0;scaled < 2  &&  ok;++scaled)
+            {
+                std::vector<double> times;
+                long long pixels = 0;
+                Image image;
+                
+                times.reserve(iterations);
+                
+                for(int iteration = 0;iteration < iterations  &&  ok;++iteration)
+                {
+                    auto start = std::chrono::steady_clock::now();
+                    
+                    for(size_t index = 0;index < images.size()  &&  ok;++index)
+                    {
+                        ok = decode(*decoder,*images[index],scaled ? width : 0,image);
+                        
+                        if(iteration == 0  &&  ok)
+                        {
+                            sizes.push_back(image.width());
+                            sizes.push_back(image.height());
+                            pixels += (long long) image.width() * image.height();
+                        }
+                    }
+                    
+                    times.push_back(std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count());
+                }
+                
+                if(!ok)
+                    break;
+                
+                
+                std::sort(times.begin(),times.end());
+                
+                double median = times[times.size() / 2];
+                
+                std::cout << "    " << std::left << std::setw(12) << ImageDecoder::name(backend)
+                          << std::setw(8) << (scaled ? "scaled" : "full")
+                          << std::right << std::fixed << std::setprecision(3)
+                          << std::setw(10) << median / images.size() << " ms/image"
+                          << std::setprecision(1) << std::setw(10) << bytes / median / 1000.0 << " MB/s"
+                          << std::setw(10) << pixels / median / 1000.0 << " Mpixels/s" << std::endl;
+            }
+            
+            if(!ok)
+            {
+                std::cout << "    " << std::left << std::setw(12) << ImageDecoder::name(backend) << "failed to decode" << std::endl;
+                agree = false;
+                continue;
+            }
+            
+            if(referenceSizes.empty())
+            {
+                referenceSizes.swap(sizes);
+            }
+            else if(!sameSizes(sizes,referenceSizes))
+            {
+                std::cout << "    " << std::left << std::setw(12) << ImageDecoder::name(backend) << "SIZE MISMATCH" << std::endl;
+                agree = false;
+            }
+        }
+    }
+    
+    return agree ? 0 : 1;
+}